@@ -15,392 +15,1984 @@
  */
 
 #include <crypto/aes.h>
+#include <crypto/authenc.h>
 #include <crypto/ctr.h>
 #include <crypto/b128ops.h>
+#include <crypto/gcm.h>
 #include <crypto/gf128mul.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/xts.h>
+#include <linux/sched/clock.h>
+#include <linux/timekeeping.h>
 #include <linux/scatterlist.h>
 #include <linux/spinlock.h>
+#include <asm/unaligned.h>
 
 #include "deu-aes.h"
 #include "deu-core.h"
+#include "deu-dma.h"
 
-static void __iomem *ltq_aes_membase;
-static DEFINE_SPINLOCK(ltq_aes_lock);
+/* The shadowed CTRL, see deu_ctrl_flush() */
+#define aes_ctrl(unit)	((union aes_control *)&(unit)->ctrl)
+
+static const union aes_control aes_ctrl_status = {
+	.bits = { .BUS = 1, .KV = 1 },
+};
+
+static const union aes_control aes_ctrl_trigger = {
+	.bits = { .PNK = 1 },
+};
+
+static inline void aes_ctrl_flush(struct deu_unit *unit)
+{
+	deu_ctrl_flush(unit, aes_ctrl_trigger.word);
+}
 
 // Init AES Engine (vr9) TODO!
-void aes_init_hw(__iomem void *base)
+void aes_init_hw(struct deu_unit *unit, __iomem void *base)
 {
-	ltq_aes_membase = base + 0x50;
+	unit->base = base + DEU_AES_BASE;
+	unit->resident_key = NULL;
 
 	if (base) {
-		struct aes_t *aes = (struct aes_t *)ltq_aes_membase;
+		union aes_control *ctrl = aes_ctrl(unit);
 
-		aes->CTRL.bits.SM = 1;
-		aes->CTRL.bits.NDC = 1;
-		wmb();
-		aes->CTRL.bits.ENDI = 1;
+		deu_ctrl_init(unit, aes_ctrl_status.word);
+		ctrl->bits.SM = 1;
+		/* no byte swap, deu_regs_write() relies on it */
+		ctrl->bits.NDC = 1;
+		aes_ctrl_flush(unit);
 		wmb();
-		aes->CTRL.bits.ARS = 0;
+		ctrl->bits.ENDI = 1;
+		ctrl->bits.ARS = 0;
+		aes_ctrl_flush(unit);
 		wmb();
 	}
 }
 
-static void aes_set_key_hw(struct deu_aes_ctx *ctx)
+/*
+ * key is ctx->key or, for the XTS tweak, ctx->tweakkey. Written to the
+ * unit with the rest of CTRL by aes_ctrl_flush().
+ */
+static void aes_load_key_hw(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			const u32 *key)
 {
-	struct aes_t *aes = (struct aes_t *)ltq_aes_membase;
-	u32 *key = ctx->key;
+	struct aes_t *aes = (struct aes_t *)unit->base;
 	int keylen = ctx->keylen;
-	u32 *keyreg = &aes->K7R;
 	int keywords = (keylen / 4);
-	int i;
 
-	if (ctx->use_tweak)
-		key = ctx->tweakkey;
+	/* still loaded and pre-processed from an earlier request */
+	if (key == unit->resident_key && ctx->key_gen == unit->resident_gen)
+		return;
+
+	aes_ctrl(unit)->bits.K = (keylen / 8) - 2;
+
+	/* shorter keys end at K0R */
+	deu_regs_write(&aes->K7R + 8 - keywords, key, keywords);
+
+	 /* let HW pre-process DEcryption key in any case(even if
+	  * ENcryption is used). Key Valid(KV) bit is then only
+	 * checked in decryption routine!
+	 */
+
+	aes_ctrl(unit)->bits.PNK = 1;
+
+	unit->resident_key = key;
+	unit->resident_gen = ctx->key_gen;
+
+	deu_stat_key_load(unit, ctx->tmpl, keylen);
+}
+
+static void aes_set_key_hw(struct deu_unit *unit, struct deu_aes_ctx *ctx)
+{
+	aes_load_key_hw(unit, ctx, ctx->key);
+}
+
+/*
+ * Run nbytes through the unit in the mode already set, IV in and out
+ * through iv. out may be NULL when only the chaining value is wanted
+ * (CBC-MAC). Data and IV may sit at any alignment: words are moved with
+ * the unaligned accessors, which are plain loads on aligned buffers, so
+ * the walk never has to bounce a misaligned packet.
+ * Called with the unit lock held and the key loaded.
+ */
+static int aes_run_locked(struct deu_unit *unit, u32 *iv, u8 *out_arg,
+			const u8 *in_arg, size_t nbytes)
+{
+	struct aes_t *aes = (struct aes_t *)unit->base;
+	const u32 *in = (const u32 *)in_arg;
+	u32 *out = (u32 *)out_arg;
+	u32 next[AES_BLOCK_SIZE / 4];
+	u32 res[AES_BLOCK_SIZE / 4];
+	bool pending = false;
+	int i = 0, j = 0;
+	int err = 0;
+
+	aes_ctrl_flush(unit);
+
+	if (iv)
+		deu_regs_write(&aes->IV3R, iv, AES_BLOCK_SIZE / 4);
+
+	next[0] = get_unaligned(&in[0]);
+	next[1] = get_unaligned(&in[1]);
+	next[2] = get_unaligned(&in[2]);
+	next[3] = get_unaligned(&in[3]);
+
+	/*
+	 * Software pipeline: with SM set the ID0R write starts the engine, so
+	 * the previous result is stored and the next input fetched while it
+	 * runs instead of after BUS clears. The input registers are only
+	 * rewritten once the result has been read.
+	 */
+	while (nbytes) {
+		deu_regs_write(&aes->ID3R, next, AES_BLOCK_SIZE / 4);
+
+		nbytes -= AES_BLOCK_SIZE;
+
+		if (pending && out) {
+			put_unaligned(res[0], &out[j + 0]);
+			put_unaligned(res[1], &out[j + 1]);
+			put_unaligned(res[2], &out[j + 2]);
+			put_unaligned(res[3], &out[j + 3]);
+			j += (AES_BLOCK_SIZE / 4);
+		}
+
+		if (nbytes) {
+			i += (AES_BLOCK_SIZE / 4);
+			next[0] = get_unaligned(&in[i + 0]);
+			next[1] = get_unaligned(&in[i + 1]);
+			next[2] = get_unaligned(&in[i + 2]);
+			next[3] = get_unaligned(&in[i + 3]);
+		}
+
+		err = deu_wait_ready(unit);
+		if (err)
+			return err;
+
+		deu_regs_read(res, &aes->OD3R, AES_BLOCK_SIZE / 4);
+		pending = true;
+	}
+
+	if (out) {
+		put_unaligned(res[0], &out[j + 0]);
+		put_unaligned(res[1], &out[j + 1]);
+		put_unaligned(res[2], &out[j + 2]);
+		put_unaligned(res[3], &out[j + 3]);
+	}
+
+	if (iv)
+		deu_regs_read(iv, &aes->IV3R, AES_BLOCK_SIZE / 4);
+
+	return 0;
+}
+
+static int aes_feed_locked(struct deu_unit *unit, int mode, u32 *iv, u8 *out,
+			const u8 *in, size_t nbytes)
+{
+	aes_ctrl(unit)->bits.O = mode;
+
+	return aes_run_locked(unit, iv, out, in, nbytes);
+}
+
+static int aes_transform_chunk(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			u32 *iv, u8 *out, const u8 *in, size_t nbytes, int mode,
+			bool enc)
+{
+	unsigned long flag;
+	int err;
+	u64 wait, start;
+
+	wait = local_clock();
+	deu_unit_lock(unit, &flag, false);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	aes_set_key_hw(unit, ctx);
+
+	aes_ctrl(unit)->bits.E_D = !enc;
+
+	err = aes_feed_locked(unit, mode, iv, out, in, nbytes);
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	return err;
+}
+
+/* Encrypt the XTS tweak in place with the second key */
+static int aes_xts_tweak_chunk(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			u8 *tweak)
+{
+	unsigned long flag;
+	int err;
+	u64 wait, start;
+
+	wait = local_clock();
+	deu_unit_lock(unit, &flag, false);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	aes_load_key_hw(unit, ctx, ctx->tweakkey);
+
+	aes_ctrl(unit)->bits.E_D = 0;
+
+	err = aes_feed_locked(unit, MODE_ECB, NULL, tweak, tweak,
+				AES_BLOCK_SIZE);
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	return err;
+}
+
+/*
+ * Both CCM passes over whole blocks under one lock hold with the key
+ * loaded once: CBC-MAC over the plaintext into mac and CTR from in to
+ * out. Either pass is skipped when its state is NULL; out is only
+ * written by CTR.
+ */
+static int aes_ccm_chunk(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			u32 *mac, u32 *ctr, u8 *out, const u8 *in,
+			size_t nbytes, bool enc)
+{
+	unsigned long flag;
+	int err = 0;
+	u64 wait, start;
+
+	wait = local_clock();
+	deu_unit_lock(unit, &flag, false);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	aes_set_key_hw(unit, ctx);
+
+	aes_ctrl(unit)->bits.E_D = 0;
+
+	/* decryption authenticates the plaintext, so CTR goes first */
+	if (ctr && !enc) {
+		err = aes_feed_locked(unit, MODE_CTR, ctr, out, in, nbytes);
+		in = out;
+	}
+
+	if (!err && mac)
+		err = aes_feed_locked(unit, MODE_CBC, mac, NULL, in, nbytes);
+
+	if (!err && ctr && enc)
+		err = aes_feed_locked(unit, MODE_CTR, ctr, out, in, nbytes);
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	return err;
+}
+
+static int deu_ccm_transform(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			u32 *mac, u32 *ctr, u8 *out, const u8 *in,
+			size_t nbytes, bool enc)
+{
+	size_t chunk, max = deu_chunk_blocks() * AES_BLOCK_SIZE;
+	int err = 0;
+
+	while (nbytes && !err) {
+		chunk = min(nbytes, max);
+		err = aes_ccm_chunk(unit, ctx, mac, ctr, out, in, chunk, enc);
+		out += chunk;
+		in += chunk;
+		nbytes -= chunk;
+	}
+
+	return err;
+}
+
+static void aes_mac_sw(struct deu_mac_ctx *ctx, u32 *dg, const u8 *in,
+			size_t nbytes)
+{
+	for (; nbytes; nbytes -= AES_BLOCK_SIZE, in += AES_BLOCK_SIZE) {
+		crypto_xor((u8 *)dg, in, AES_BLOCK_SIZE);
+		aes_encrypt(&ctx->sw, (u8 *)dg, (u8 *)dg);
+	}
+}
+
+/*
+ * CBC-MAC over whole blocks, the running MAC goes through the IV
+ * registers. shash callers cannot wait out a DMA transfer or a parked
+ * section, so while the unit is owned the blocks are done in software.
+ */
+static int aes_mac_chunk(struct deu_unit *unit, struct deu_mac_ctx *ctx,
+			u32 *dg, const u8 *in, size_t nbytes)
+{
+	unsigned long flag;
+	int err;
+	u64 wait, start;
+
+	wait = local_clock();
+	if (!deu_unit_trylock(unit, &flag)) {
+		aes_mac_sw(ctx, dg, in, nbytes);
+		return 0;
+	}
+
+	start = deu_lock_taken(unit, ctx->aes.tmpl, wait);
+
+	aes_set_key_hw(unit, &ctx->aes);
+
+	aes_ctrl(unit)->bits.E_D = 0;
+
+	err = aes_feed_locked(unit, MODE_CBC, dg, NULL, in, nbytes);
+
+	deu_account_hold(unit, ctx->aes.tmpl, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	return err;
+}
+
+static int deu_mac_transform(struct deu_unit *unit, struct deu_mac_ctx *ctx,
+			u32 *dg, const u8 *in, size_t nbytes)
+{
+	size_t chunk, max = deu_chunk_blocks() * AES_BLOCK_SIZE;
+	int err = 0;
+
+	/* no instance bound any more, the key is still in ctx->sw */
+	if (!unit) {
+		aes_mac_sw(ctx, dg, in, nbytes);
+		return 0;
+	}
+
+	while (nbytes && !err) {
+		chunk = min(nbytes, max);
+		err = aes_mac_chunk(unit, ctx, dg, in, chunk);
+		in += chunk;
+		nbytes -= chunk;
+	}
+
+	return err;
+}
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+/*
+ * CBC on the AES unit and the HMAC inner hash on the hash unit in one
+ * pass: while the AES unit works on a block, the hash unit is fed the
+ * ciphertext block before it (or the input block itself on decryption),
+ * so both units run together and the data is read from memory once.
+ */
+static int aes_authenc_chunk(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			struct deu_hash_stream *hs, u32 *iv, u8 *out,
+			const u8 *in, size_t nbytes, bool enc)
+{
+	struct deu_unit *hu = &unit->deu->units[DEU_UNIT_HASH];
+	struct aes_t *aes = (struct aes_t *)unit->base;
+	const u32 *src = (const u32 *)in;
+	u32 *dst = (u32 *)out;
+	unsigned long flag;
+	size_t i, j;
+	int err = 0;
+	u64 wait, start;
+
+	/* both units of the same instance, the AES lock always first */
+	wait = local_clock();
+	deu_unit_lock_pair(unit, hu, &flag);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	aes_set_key_hw(unit, ctx);
+
+	aes_ctrl(unit)->bits.E_D = !enc;
+	aes_ctrl(unit)->bits.O = MODE_CBC;
+	aes_ctrl_flush(unit);
+
+	deu_regs_write(&aes->IV3R, iv, AES_BLOCK_SIZE / 4);
+
+	deu_hash_begin_locked(hu, hs);
+
+	for (i = 0; i < nbytes; i += AES_BLOCK_SIZE) {
+		j = i / 4;
+
+		deu_regs_write(&aes->ID3R, &src[j], AES_BLOCK_SIZE / 4);
+
+		if (!enc)
+			err = deu_hash_feed_locked(hu, hs, in + i,
+						AES_BLOCK_SIZE);
+		else if (i)
+			err = deu_hash_feed_locked(hu, hs,
+						out + i - AES_BLOCK_SIZE,
+						AES_BLOCK_SIZE);
+		if (!err)
+			err = deu_wait_ready(unit);
+		if (err)
+			goto out;
+
+		deu_regs_read(&dst[j], &aes->OD3R, AES_BLOCK_SIZE / 4);
+	}
+
+	if (enc)
+		err = deu_hash_feed_locked(hu, hs,
+					out + nbytes - AES_BLOCK_SIZE,
+					AES_BLOCK_SIZE);
+	if (!err)
+		err = deu_hash_end_locked(hu, hs);
+
+	deu_regs_read(iv, &aes->IV3R, AES_BLOCK_SIZE / 4);
+
+out:
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_hash_account_locked(hu, ctx->tmpl, wait, start);
+	deu_unit_unlock_pair(unit, hu, &flag);
+
+	return err;
+}
+
+static int deu_authenc_transform(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			struct deu_hash_stream *hs, u32 *iv, u8 *out,
+			const u8 *in, size_t nbytes, bool enc)
+{
+	size_t chunk, max = deu_chunk_blocks() * AES_BLOCK_SIZE;
+	int err = 0;
+
+	while (nbytes && !err) {
+		chunk = min(nbytes, max);
+		err = aes_authenc_chunk(unit, ctx, hs, iv, out, in, chunk, enc);
+		out += chunk;
+		in += chunk;
+		nbytes -= chunk;
+	}
+
+	return err;
+}
+#endif
+
+static int deu_transform_block(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			u32 *iv, u8 *out, const u8 *in, size_t nbytes, int mode,
+			bool enc)
+{
+	size_t chunk, max = deu_chunk_blocks() * AES_BLOCK_SIZE;
+	int err = 0;
+
+	while (nbytes && !err) {
+		chunk = min(nbytes, max);
+		err = aes_transform_chunk(unit, ctx, iv, out, in, chunk, mode,
+					enc);
+		out += chunk;
+		in += chunk;
+		nbytes -= chunk;
+	}
+
+	return err;
+}
+
+/* One XTS block: whiten with t, single ECB block, whiten again */
+static int deu_aes_xts_block(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			u8 *out, const u8 *in, const le128 *t, bool enc)
+{
+	int err;
+
+	crypto_xor_cpy(out, in, (const u8 *)t, AES_BLOCK_SIZE);
+	err = deu_transform_block(unit, ctx, NULL, out, out, AES_BLOCK_SIZE,
+				MODE_ECB, enc);
+	crypto_xor(out, (const u8 *)t, AES_BLOCK_SIZE);
+
+	return err;
+}
+
+/*
+ * XTS in two passes per batch: the tweaks are computed into the request's
+ * scratch first and XORed over the whole batch, which then streams through
+ * the engine in ECB mode without an IV register write per block. A partial
+ * final block is handled by ciphertext stealing over the last two blocks.
+ * iv holds the current tweak on entry and the next one on return.
+ */
+static int deu_aes_xts_transform(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			le128 *tweaks, u32 *iv, u8 *out, const u8 *in,
+			size_t nbytes, bool enc)
+{
+	unsigned int blocks = nbytes / AES_BLOCK_SIZE;
+	unsigned int tail = nbytes % AES_BLOCK_SIZE;
+	u8 cc[AES_BLOCK_SIZE], pp[AES_BLOCK_SIZE];
+	unsigned int i, n, len;
+	le128 t, t2;
+	int err;
+
+	memcpy(&t, iv, AES_BLOCK_SIZE);
+
+	/* with stealing the last full block goes with the tail */
+	if (tail)
+		blocks--;
+
+	while (blocks) {
+		n = min_t(unsigned int, blocks, DEU_XTS_BATCH);
+		len = n * AES_BLOCK_SIZE;
+
+		for (i = 0; i < n; i++) {
+			tweaks[i] = t;
+			gf128mul_x_ble(&t, &t);
+		}
+
+		crypto_xor_cpy(out, in, (const u8 *)tweaks, len);
+		err = deu_transform_block(unit, ctx, NULL, out, out, len,
+					MODE_ECB, enc);
+		if (err)
+			return err;
+		crypto_xor(out, (const u8 *)tweaks, len);
+
+		out += len;
+		in += len;
+		blocks -= n;
+	}
+
+	if (tail) {
+		/* decryption uses the two tweaks in reverse order */
+		gf128mul_x_ble(&t2, &t);
+
+		err = deu_aes_xts_block(unit, ctx, cc, in, enc ? &t : &t2, enc);
+		if (err)
+			return err;
+
+		memcpy(pp, in + AES_BLOCK_SIZE, tail);
+		memcpy(pp + tail, cc + tail, AES_BLOCK_SIZE - tail);
+		memcpy(out + AES_BLOCK_SIZE, cc, tail);
+
+		err = deu_aes_xts_block(unit, ctx, out, pp, enc ? &t2 : &t,
+					enc);
+		if (err)
+			return err;
+
+		gf128mul_x_ble(&t, &t2);
+	}
+
+	memcpy(iv, &t, AES_BLOCK_SIZE);
+
+	return 0;
+}
+
+static int deu_aes_dma_crypt(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			struct skcipher_request *req, int mode, bool enc)
+{
+	struct aes_t *aes = (struct aes_t *)unit->base;
+	u32 ivbuf[AES_BLOCK_SIZE / 4];
+	bool iv_out = (mode > 0 && mode != MODE_RFC3686);
+	u32 *iv = NULL;
+	unsigned long flag;
+	int err;
+	u64 wait, start;
+
+	if (mode == MODE_RFC3686) {
+		ivbuf[0] = ctx->nonce;
+		memcpy(&ivbuf[1], req->iv, CTR_RFC3686_IV_SIZE);
+		ivbuf[3] = cpu_to_be32(1);
+		iv = ivbuf;
+		mode = MODE_CTR;
+	} else if (mode > 0) {
+		memcpy(ivbuf, req->iv, AES_BLOCK_SIZE);
+		iv = ivbuf;
+	}
+
+	wait = local_clock();
+	deu_unit_lock(unit, &flag, false);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	aes_set_key_hw(unit, ctx);
+
+	aes_ctrl(unit)->bits.E_D = !enc;
+	aes_ctrl(unit)->bits.O = mode;
+	aes_ctrl_flush(unit);
+
+	if (iv)
+		deu_regs_write(&aes->IV3R, iv, AES_BLOCK_SIZE / 4);
+
+	/* DMA feeds ID and drains OD, restart the engine on every block */
+	aes_ctrl(unit)->bits.DAU = 1;
+	aes_ctrl(unit)->bits.ARS = 1;
+	aes_ctrl_flush(unit);
+	unit->owned = true;
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	/* only the engine worker drives the unit, it stays ours meanwhile */
+	err = deu_dma_transfer(unit, DEU_DMA_ALGO_AES, req->src, req->dst,
+				req->cryptlen);
+
+	/* still owned by us, so not deu_unit_lock() */
+	wait = local_clock();
+	spin_lock_irqsave(&unit->lock, flag);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	aes_ctrl(unit)->bits.ARS = 0;
+	aes_ctrl(unit)->bits.DAU = 0;
+	aes_ctrl_flush(unit);
+	unit->owned = false;
+
+	if (iv)
+		deu_regs_read(iv, &aes->IV3R, AES_BLOCK_SIZE / 4);
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	spin_unlock_irqrestore(&unit->lock, flag);
+
+	if (iv_out)
+		memcpy(req->iv, ivbuf, AES_BLOCK_SIZE);
+
+	return err;
+}
+
+static int deu_skcipher_crypt(struct deu_unit *unit,
+			struct skcipher_request *req, int mode, bool enc)
+{
+	struct deu_aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct skcipher_walk walk;
+	unsigned int blk_bytes, nbytes;
+	u32 *iv = NULL;
+	u32 rfc3686iv[AES_BLOCK_SIZE / 4];
+	int err;
+
+	if (deu_dma_capable(unit, req->src, req->dst, req->cryptlen,
+				AES_BLOCK_SIZE))
+		return deu_aes_dma_crypt(unit, ctx, req, mode, enc);
+
+	err = skcipher_walk_virt(&walk, req, false);
+
+	if (mode > 0)
+		iv = (u32 *)walk.iv;
+
+	if (mode == MODE_RFC3686) {
+		rfc3686iv[0] = ctx->nonce;
+		rfc3686iv[1] = get_unaligned(&iv[0]);
+		rfc3686iv[2] = get_unaligned(&iv[1]);
+		rfc3686iv[3] = cpu_to_be32(1);
+		iv = rfc3686iv;
+		mode = MODE_CTR;
+	}
+
+	while ((nbytes = blk_bytes = walk.nbytes) &&
+					(walk.nbytes >= AES_BLOCK_SIZE)) {
+		blk_bytes -= (nbytes % AES_BLOCK_SIZE);
+
+		err = deu_transform_block(unit, ctx, iv, walk.dst.virt.addr,
+				walk.src.virt.addr, blk_bytes, mode, enc);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
+		nbytes &= AES_BLOCK_SIZE - 1;
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
+		err = skcipher_walk_done(&walk, nbytes);
+	}
+	/* For stream ciphers handle last block
+	 * less than AES_BLOCK_SIZE (ofb, cfb and ctr)
+	 */
+	if (walk.nbytes) {
+		u8 buf[AES_BLOCK_SIZE];
+
+		memcpy(&buf, walk.src.virt.addr, nbytes);
+		err = deu_transform_block(unit, ctx, iv, buf, buf,
+						AES_BLOCK_SIZE, mode, enc);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
+
+		memcpy(walk.dst.virt.addr, &buf, nbytes);
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
+		err = skcipher_walk_done(&walk, 0);
+	}
+
+	return err;
+}
+
+static unsigned int deu_aes_xts_offset(struct deu_aes_ctx *ctx)
+{
+	return ALIGN(sizeof(struct deu_aes_reqctx) +
+			crypto_skcipher_reqsize(ctx->fallback),
+			__alignof__(struct deu_aes_xts_reqctx));
+}
+
+/*
+ * The whole blocks before a stolen tail are walked through a copy of the
+ * request that ends before them, so no walk step is still mapped when
+ * the tail, the last full block and the partial one, is copied out and
+ * run from lastbuffer.
+ */
+static int deu_aes_xts_crypt(struct deu_unit *unit,
+			struct skcipher_request *req, bool enc)
+{
+	struct deu_aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct deu_aes_reqctx *brctx = skcipher_request_ctx(req);
+	struct deu_aes_xts_reqctx *rctx = skcipher_request_ctx(req) +
+						deu_aes_xts_offset(ctx);
+	struct skcipher_request *subreq = &brctx->fallback_req;
+	unsigned int tail = req->cryptlen % XTS_BLOCK_SIZE;
+	unsigned int head = req->cryptlen;
+	struct skcipher_walk walk;
+	u32 iv[XTS_BLOCK_SIZE / 4];
+	unsigned int blk_bytes, nbytes;
+	int err;
+
+	if (tail) {
+		tail += XTS_BLOCK_SIZE;
+		head -= tail;
+	}
+
+	memcpy(iv, req->iv, XTS_BLOCK_SIZE);
+	err = aes_xts_tweak_chunk(unit, ctx, (u8 *)iv);
+	if (err)
+		return err;
+
+	if (head) {
+		skcipher_request_set_tfm(subreq, crypto_skcipher_reqtfm(req));
+		skcipher_request_set_callback(subreq,
+				skcipher_request_flags(req), NULL, NULL);
+		skcipher_request_set_crypt(subreq, req->src, req->dst, head,
+				req->iv);
+
+		err = skcipher_walk_virt(&walk, subreq, false);
+		if (err)
+			return err;
+
+		while ((nbytes = walk.nbytes)) {
+			blk_bytes = nbytes & ~(XTS_BLOCK_SIZE - 1);
+
+			err = deu_aes_xts_transform(unit, ctx, rctx->tweaks,
+					iv, walk.dst.virt.addr,
+					walk.src.virt.addr, blk_bytes, enc);
+			if (err) {
+				skcipher_walk_done(&walk, err);
+				return err;
+			}
+			deu_stat_walk(unit, ctx->tmpl, blk_bytes, enc);
+			err = skcipher_walk_done(&walk, nbytes - blk_bytes);
+		}
+		if (err)
+			return err;
+	}
+
+	if (tail) {
+		scatterwalk_map_and_copy(rctx->lastbuffer, req->src, head,
+					tail, 0);
+		err = deu_aes_xts_transform(unit, ctx, rctx->tweaks, iv,
+				rctx->lastbuffer, rctx->lastbuffer, tail, enc);
+		if (err)
+			return err;
+		scatterwalk_map_and_copy(rctx->lastbuffer, req->dst, head,
+					tail, 1);
+		deu_stat_walk(unit, ctx->tmpl, tail, enc);
+	}
+
+	return 0;
+}
+
+/* One batched request; lock held, key loaded, E_D and O already set */
+static int aes_batch_one_locked(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			struct skcipher_request *req, int mode)
+{
+	struct deu_aes_reqctx *rctx = skcipher_request_ctx(req);
+	u32 rfc3686iv[AES_BLOCK_SIZE / 4];
+	unsigned int blk_bytes, nbytes;
+	struct skcipher_walk walk;
+	u32 *iv = NULL;
+	int err;
+
+	/* the atomic copy set up by deu_skcipher_do_one() */
+	err = skcipher_walk_virt(&walk, &rctx->fallback_req, true);
+
+	if (mode > 0)
+		iv = (u32 *)walk.iv;
+
+	if (mode == MODE_RFC3686) {
+		rfc3686iv[0] = ctx->nonce;
+		rfc3686iv[1] = get_unaligned(&iv[0]);
+		rfc3686iv[2] = get_unaligned(&iv[1]);
+		rfc3686iv[3] = cpu_to_be32(1);
+		iv = rfc3686iv;
+	}
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		blk_bytes = nbytes & ~(AES_BLOCK_SIZE - 1);
+
+		err = aes_run_locked(unit, iv, walk.dst.virt.addr,
+				walk.src.virt.addr, blk_bytes);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
+
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, rctx->enc);
+		err = skcipher_walk_done(&walk, nbytes - blk_bytes);
+	}
+
+	/* last partial block of ofb, cfb and ctr */
+	if (walk.nbytes) {
+		u8 buf[AES_BLOCK_SIZE];
+
+		memcpy(buf, walk.src.virt.addr, nbytes);
+		err = aes_run_locked(unit, iv, buf, buf, AES_BLOCK_SIZE);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
+
+		memcpy(walk.dst.virt.addr, buf, nbytes);
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, rctx->enc);
+		err = skcipher_walk_done(&walk, 0);
+	}
+
+	return err;
+}
+
+/*
+ * Run a batch of small skcipher requests back to back. Between requests
+ * only the IV and data registers change unless the key, direction or
+ * mode differ. The lock is still dropped every max_blocks blocks.
+ */
+static void deu_aes_batch_run(struct deu_unit *unit,
+			struct crypto_async_request **reqs, unsigned int n)
+{
+	unsigned int budget = deu_chunk_blocks();
+	struct deu_alg_template *tmpl, *owner = NULL;
+	struct skcipher_request *req;
+	struct deu_aes_reqctx *rctx;
+	struct deu_aes_ctx *ctx;
+	int err[DEU_BATCH_MAX];
+	unsigned int i, blocks;
+	unsigned long flag;
+	int mode;
+	u64 wait, start;
+
+	/* lock time goes to the algorithm, NULL when the batch mixes them */
+	for (i = 0; i < n; i++) {
+		tmpl = container_of(reqs[i]->tfm->__crt_alg,
+				struct deu_alg_template, alg.skcipher.base);
+		if (!i)
+			owner = tmpl;
+		else if (owner != tmpl)
+			owner = NULL;
+	}
+
+	wait = local_clock();
+	deu_unit_lock(unit, &flag, false);
+	start = deu_lock_taken(unit, owner, wait);
+
+	for (i = 0; i < n; i++) {
+		req = skcipher_request_cast(reqs[i]);
+		ctx = crypto_tfm_ctx(req->base.tfm);
+		rctx = skcipher_request_ctx(req);
+		tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.skcipher.base);
+
+		blocks = DIV_ROUND_UP(req->cryptlen, AES_BLOCK_SIZE);
+		if (blocks > budget) {
+			deu_account_hold(unit, owner, wait, start);
+			deu_unit_unlock(unit, &flag);
+			wait = local_clock();
+			deu_unit_lock(unit, &flag, false);
+			start = deu_lock_taken(unit, owner, wait);
+
+			budget = deu_chunk_blocks();
+		}
+		budget -= min(blocks, budget);
+
+		aes_set_key_hw(unit, ctx);
+
+		/* only written when it changed, see aes_ctrl_flush() */
+		mode = tmpl->mode == MODE_RFC3686 ? MODE_CTR : tmpl->mode;
+		aes_ctrl(unit)->bits.E_D = !rctx->enc;
+		aes_ctrl(unit)->bits.O = mode;
+
+		err[i] = aes_batch_one_locked(unit, ctx, req, tmpl->mode);
+	}
+
+	deu_account_hold(unit, owner, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	for (i = 0; i < n; i++) {
+		req = skcipher_request_cast(reqs[i]);
+		rctx = skcipher_request_ctx(req);
+		tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.skcipher.base);
+		deu_put_unit(unit);
+		deu_stat_done(tmpl, rctx->queued, req->cryptlen, rctx->enc,
+				err[i]);
+		crypto_finalize_skcipher_request(unit->engine, req, err[i]);
+	}
+}
+
+/* GHASH over len bytes, a partial final block is zero padded */
+static void deu_gcm_ghash(struct deu_aes_ctx *ctx, be128 *x, const u8 *src,
+			unsigned int len)
+{
+	unsigned int n;
+
+	while (len) {
+		n = min_t(unsigned int, len, AES_BLOCK_SIZE);
+		crypto_xor((u8 *)x, src, n);
+		gf128mul_4k_lle(x, ctx->ghash);
+		src += n;
+		len -= n;
+	}
+}
+
+static void deu_gcm_ghash_sg(struct deu_aes_ctx *ctx, be128 *x,
+			struct scatterlist *sg, unsigned int len)
+{
+	u8 buf[4 * AES_BLOCK_SIZE];
+	unsigned int offset, n;
+
+	for (offset = 0; offset < len; offset += n) {
+		n = min_t(unsigned int, len - offset, sizeof(buf));
+		scatterwalk_map_and_copy(buf, sg, offset, n, 0);
+		deu_gcm_ghash(ctx, x, buf, n);
+	}
+}
+
+/*
+ * GCM with the DEU producing E(K, J0) and the CTR keystream. GHASH runs
+ * with the 4k table over each walk step right after (encrypt) or before
+ * (decrypt) the engine, so the payload is only walked once.
+ */
+static int deu_aead_gcm_crypt(struct deu_unit *unit, struct aead_request *req,
+			int mode, bool enc)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	unsigned int assoclen = req->assoclen;
+	unsigned int cryptlen = req->cryptlen;
+	unsigned int nbytes, blk_bytes;
+	struct skcipher_walk walk;
+	u32 ctr[AES_BLOCK_SIZE / 4];
+	u8 ekj0[AES_BLOCK_SIZE];
+	u8 tag[AES_BLOCK_SIZE];
+	u8 buf[AES_BLOCK_SIZE];
+	__be64 lens[2];
+	be128 x = {};
+	int err;
+
+	if (!enc)
+		cryptlen -= authsize;
+
+	if (mode == MODE_RFC4106) {
+		/* the explicit IV is part of assoclen but not authenticated */
+		assoclen -= GCM_RFC4106_IV_SIZE;
+		ctr[0] = ctx->nonce;
+		memcpy(&ctr[1], req->iv, GCM_RFC4106_IV_SIZE);
+	} else {
+		memcpy(ctr, req->iv, GCM_AES_IV_SIZE);
+	}
+	ctr[3] = cpu_to_be32(1);
+
+	err = deu_transform_block(unit, ctx, NULL, ekj0, (u8 *)ctr,
+				AES_BLOCK_SIZE, MODE_ECB, true);
+	if (err)
+		return err;
+
+	/* the payload counter starts at J0 + 1 */
+	ctr[3] = cpu_to_be32(2);
+
+	deu_gcm_ghash_sg(ctx, &x, req->src, assoclen);
+
+	if (enc)
+		err = skcipher_walk_aead_encrypt(&walk, req, false);
+	else
+		err = skcipher_walk_aead_decrypt(&walk, req, false);
+
+	while ((nbytes = walk.nbytes)) {
+		const u8 *src = walk.src.virt.addr;
+		u8 *dst = walk.dst.virt.addr;
+
+		if (nbytes < walk.total)
+			nbytes = round_down(nbytes, AES_BLOCK_SIZE);
+		blk_bytes = round_down(nbytes, AES_BLOCK_SIZE);
+
+		if (!enc)
+			deu_gcm_ghash(ctx, &x, src, nbytes);
+
+		err = deu_transform_block(unit, ctx, ctr, dst, src, blk_bytes,
+					MODE_CTR, true);
+		if (!err && nbytes > blk_bytes) {
+			memcpy(buf, src + blk_bytes, nbytes - blk_bytes);
+			err = deu_transform_block(unit, ctx, ctr, buf, buf,
+					AES_BLOCK_SIZE, MODE_CTR, true);
+			memcpy(dst + blk_bytes, buf, nbytes - blk_bytes);
+		}
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
+
+		if (enc)
+			deu_gcm_ghash(ctx, &x, dst, nbytes);
+
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
+		err = skcipher_walk_done(&walk, walk.nbytes - nbytes);
+	}
+	if (err)
+		return err;
+
+	lens[0] = cpu_to_be64((u64)assoclen * 8);
+	lens[1] = cpu_to_be64((u64)cryptlen * 8);
+	deu_gcm_ghash(ctx, &x, (u8 *)lens, sizeof(lens));
+	crypto_xor_cpy(tag, (u8 *)&x, ekj0, AES_BLOCK_SIZE);
+
+	if (enc) {
+		scatterwalk_map_and_copy(tag, req->dst,
+				req->assoclen + cryptlen, authsize, 1);
+		return 0;
+	}
+
+	scatterwalk_map_and_copy(buf, req->src, req->assoclen + cryptlen,
+				authsize, 0);
+
+	return crypto_memneq(tag, buf, authsize) ? -EBADMSG : 0;
+}
+
+/* Feed the CBC-MAC with B0, the encoded AAD length and the AAD */
+static int deu_ccm_mac_assoc(struct deu_unit *unit, struct deu_aes_ctx *ctx,
+			u32 *mac, const u8 *b0, struct scatterlist *sg,
+			unsigned int assoclen)
+{
+	u8 buf[4 * AES_BLOCK_SIZE];
+	unsigned int pos = AES_BLOCK_SIZE;
+	unsigned int offset, len;
+	int err;
+
+	memcpy(buf, b0, AES_BLOCK_SIZE);
+
+	if (assoclen) {
+		if (assoclen < 0xff00) {
+			put_unaligned_be16(assoclen, buf + pos);
+			pos += 2;
+		} else {
+			put_unaligned_be16(0xfffe, buf + pos);
+			put_unaligned_be32(assoclen, buf + pos + 2);
+			pos += 6;
+		}
+	}
+
+	for (offset = 0; offset < assoclen; offset += len) {
+		len = min_t(unsigned int, assoclen - offset, sizeof(buf) - pos);
+		scatterwalk_map_and_copy(buf + pos, sg, offset, len, 0);
+		pos += len;
+
+		if (pos == sizeof(buf)) {
+			err = deu_ccm_transform(unit, ctx, mac, NULL, buf, buf,
+						pos, true);
+			if (err)
+				return err;
+			pos = 0;
+		}
+	}
+
+	if (!pos)
+		return 0;
+
+	len = round_up(pos, AES_BLOCK_SIZE);
+	memset(buf + pos, 0, len - pos);
+
+	return deu_ccm_transform(unit, ctx, mac, NULL, buf, buf, len, true);
+}
+
+/*
+ * CCM (RFC 3610) with the CBC-MAC and CTR passes over each walk step run
+ * back to back in one lock hold, see aes_ccm_chunk().
+ */
+static int deu_aead_ccm_crypt(struct deu_unit *unit, struct aead_request *req,
+			int mode, bool enc)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	unsigned int assoclen = req->assoclen;
+	unsigned int cryptlen = req->cryptlen;
+	unsigned int nbytes, blk_bytes, tail, l;
+	struct skcipher_walk walk;
+	u32 ctr[AES_BLOCK_SIZE / 4];
+	u32 mac[AES_BLOCK_SIZE / 4] = {};
+	u32 a0[AES_BLOCK_SIZE / 4];
+	u8 *iv = (u8 *)ctr;
+	u8 b0[AES_BLOCK_SIZE];
+	u8 buf[AES_BLOCK_SIZE];
+	u8 tag[AES_BLOCK_SIZE];
+	__be32 msglen;
+	int err;
+
+	if (!enc)
+		cryptlen -= authsize;
+
+	if (mode == MODE_RFC4309) {
+		/* the explicit IV is part of assoclen but not authenticated */
+		assoclen -= 8;
+		iv[0] = 3;
+		memcpy(iv + 1, &ctx->nonce, 3);
+		memcpy(iv + 4, req->iv, 8);
+	} else {
+		memcpy(iv, req->iv, AES_BLOCK_SIZE);
+	}
+
+	/* A0: the counter field is zero */
+	l = iv[0] + 1;
+	memset(iv + AES_BLOCK_SIZE - l, 0, l);
+	memcpy(a0, ctr, AES_BLOCK_SIZE);
+
+	/* B0: flags, nonce and the message length in the counter field */
+	memcpy(b0, iv, AES_BLOCK_SIZE);
+	b0[0] |= ((authsize - 2) / 2) << 3;
+	if (assoclen)
+		b0[0] |= 0x40;
+	if (l < 4 && cryptlen >> (8 * l))
+		return -EOVERFLOW;
+	msglen = cpu_to_be32(cryptlen);
+	l = min(l, 4U);
+	memcpy(b0 + AES_BLOCK_SIZE - l, (u8 *)&msglen + 4 - l, l);
+
+	err = deu_ccm_mac_assoc(unit, ctx, mac, b0, req->src, assoclen);
+	if (err)
+		return err;
+
+	/* the payload counter starts at 1 */
+	iv[AES_BLOCK_SIZE - 1] = 1;
+
+	if (enc)
+		err = skcipher_walk_aead_encrypt(&walk, req, false);
+	else
+		err = skcipher_walk_aead_decrypt(&walk, req, false);
+
+	while ((nbytes = walk.nbytes)) {
+		const u8 *src = walk.src.virt.addr;
+		u8 *dst = walk.dst.virt.addr;
+
+		if (nbytes < walk.total)
+			nbytes = round_down(nbytes, AES_BLOCK_SIZE);
+		blk_bytes = round_down(nbytes, AES_BLOCK_SIZE);
+
+		err = deu_ccm_transform(unit, ctx, mac, ctr, dst, src,
+					blk_bytes, enc);
+
+		/* the MAC covers the zero padded plaintext */
+		tail = nbytes - blk_bytes;
+		if (!err && tail) {
+			memset(buf, 0, AES_BLOCK_SIZE);
+			memcpy(buf, src + blk_bytes, tail);
+			if (enc) {
+				err = deu_ccm_transform(unit, ctx, mac, ctr,
+						buf, buf, AES_BLOCK_SIZE, true);
+			} else {
+				err = deu_ccm_transform(unit, ctx, NULL,
+						ctr, buf, buf, AES_BLOCK_SIZE,
+						false);
+				memset(buf + tail, 0, AES_BLOCK_SIZE - tail);
+				if (!err)
+					err = deu_ccm_transform(unit, ctx, mac,
+						NULL, buf, buf, AES_BLOCK_SIZE,
+						false);
+			}
+			memcpy(dst + blk_bytes, buf, tail);
+		}
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
+
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
+		err = skcipher_walk_done(&walk, walk.nbytes - nbytes);
+	}
+	if (err)
+		return err;
+
+	err = deu_transform_block(unit, ctx, NULL, buf, (u8 *)a0,
+				AES_BLOCK_SIZE, MODE_ECB, true);
+	if (err)
+		return err;
+
+	crypto_xor_cpy(tag, (u8 *)mac, buf, AES_BLOCK_SIZE);
+
+	if (enc) {
+		scatterwalk_map_and_copy(tag, req->dst,
+				req->assoclen + cryptlen, authsize, 1);
+		return 0;
+	}
+
+	scatterwalk_map_and_copy(buf, req->src, req->assoclen + cryptlen,
+				authsize, 0);
+
+	return crypto_memneq(tag, buf, authsize) ? -EBADMSG : 0;
+}
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+/* authenc(hmac(sha1),cbc(aes)): encrypt-then-MAC over AAD and ciphertext */
+static int deu_aead_authenc_crypt(struct deu_unit *unit,
+			struct aead_request *req, bool enc)
+{
+	struct deu_unit *hu = &unit->deu->units[DEU_UNIT_HASH];
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	unsigned int cryptlen = req->cryptlen;
+	struct deu_hash_stream hs;
+	struct skcipher_walk walk;
+	u8 tag[SHA1_DIGEST_SIZE];
+	u8 buf[SHA1_DIGEST_SIZE];
+	unsigned int nbytes;
+	int err;
+
+	if (!enc)
+		cryptlen -= authsize;
+
+	if (cryptlen % AES_BLOCK_SIZE)
+		return -EINVAL;
+
+	deu_hash_stream_init(&hs, HASH_ALGM_SHA1, ctx->hmac.istate,
+				DEU_HASH_BLOCK_SIZE);
+	hs.tmpl = ctx->tmpl;
+	err = deu_hash_stream_update_sg(hu, &hs, req->src, req->assoclen);
+	if (err)
+		return err;
+
+	/* the walk steps cannot wait for the hash unit, own it meanwhile */
+	deu_unit_claim(hu);
+	if (enc)
+		err = skcipher_walk_aead_encrypt(&walk, req, false);
+	else
+		err = skcipher_walk_aead_decrypt(&walk, req, false);
+
+	while ((nbytes = walk.nbytes)) {
+		err = deu_authenc_transform(unit, ctx, &hs, (u32 *)walk.iv,
+				walk.dst.virt.addr, walk.src.virt.addr,
+				nbytes, enc);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			break;
+		}
+
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
+		err = skcipher_walk_done(&walk, 0);
+	}
+	deu_unit_release(hu);
+	if (err)
+		return err;
+
+	err = deu_hmac_final(hu, &hs, &ctx->hmac, tag);
+	if (err)
+		return err;
+
+	if (enc) {
+		scatterwalk_map_and_copy(tag, req->dst,
+				req->assoclen + cryptlen, authsize, 1);
+		return 0;
+	}
+
+	scatterwalk_map_and_copy(buf, req->src, req->assoclen + cryptlen,
+				authsize, 0);
+
+	return crypto_memneq(tag, buf, authsize) ? -EBADMSG : 0;
+}
+#endif
+
+/* Crypto API */
+static int deu_aes_setkey(struct deu_aes_ctx *ctx, const u8 *key,
+			unsigned int len)
+{
+	switch (len) {
+	case AES_KEYSIZE_128:
+	case AES_KEYSIZE_192:
+	case AES_KEYSIZE_256:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ctx->keylen = len;
+	memcpy(&ctx->key, key, len);
+	ctx->key_gen = deu_next_key_gen();
+
+	return 0;
+}
+
+static int deu_skcipher_fallback_setkey(struct crypto_skcipher *tfm,
+				const u8 *key, unsigned int len)
+{
+	struct deu_aes_ctx *ctx = crypto_skcipher_ctx(tfm);
+
+	crypto_skcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_skcipher_set_flags(ctx->fallback, crypto_skcipher_get_flags(tfm) &
+						CRYPTO_TFM_REQ_MASK);
+
+	return crypto_skcipher_setkey(ctx->fallback, key, len);
+}
+
+static int deu_skcipher_setkey(struct crypto_skcipher *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct crypto_tfm *ctfm = crypto_skcipher_tfm(tfm);
+	struct deu_aes_ctx *ctx = crypto_tfm_ctx(ctfm);
+	int err;
+
+	err = deu_aes_setkey(ctx, key, len);
+	if (err)
+		return err;
+
+	return deu_skcipher_fallback_setkey(tfm, key, len);
+}
+
+static int deu_skcipher_rfc3686_setkey(struct crypto_skcipher *tfm,
+				const u8 *key, unsigned int len)
+{
+	struct crypto_tfm *ctfm = crypto_skcipher_tfm(tfm);
+	struct deu_aes_ctx *ctx = crypto_tfm_ctx(ctfm);
+	unsigned int keylen;
+	int err;
+
+	if (!key || !len)
+		return -EINVAL;
+
+	if (len < CTR_RFC3686_NONCE_SIZE)
+		return -EINVAL;
+
+	keylen = len - CTR_RFC3686_NONCE_SIZE;
+	memcpy(&ctx->nonce, key + keylen, CTR_RFC3686_NONCE_SIZE);
+
+	err = deu_aes_setkey(ctx, key, keylen);
+	if (err)
+		return err;
+
+	return deu_skcipher_fallback_setkey(tfm, key, len);
+}
+
+static int deu_skcipher_xts_setkey(struct crypto_skcipher *tfm,
+				const u8 *key, unsigned int keylen)
+{
+	struct deu_aes_ctx *ctx = crypto_tfm_ctx(crypto_skcipher_tfm(tfm));
+	unsigned int len = (keylen / 2);
+	int err;
+
+	if (keylen % 2)
+		return -EINVAL;
+
+	memcpy(&ctx->tweakkey, key + len, len);
+
+	err = deu_aes_setkey(ctx, key, len);
+	if (err)
+		return err;
+
+	return deu_skcipher_fallback_setkey(tfm, key, keylen);
+}
+
+/* Small requests are cheaper in software than lock, key and MMIO setup */
+static int deu_skcipher_fallback(struct skcipher_request *req, bool enc)
+{
+	struct deu_aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct deu_aes_reqctx *rctx = skcipher_request_ctx(req);
+	struct skcipher_request *subreq = &rctx->fallback_req;
+
+	skcipher_request_set_tfm(subreq, ctx->fallback);
+	skcipher_request_set_callback(subreq, req->base.flags,
+				req->base.complete, req->base.data);
+	skcipher_request_set_crypt(subreq, req->src, req->dst,
+				req->cryptlen, req->iv);
+
+	return enc ? crypto_skcipher_encrypt(subreq) :
+			crypto_skcipher_decrypt(subreq);
+}
+
+static int deu_aead_fallback_setkey(struct crypto_aead *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+
+	crypto_aead_clear_flags(ctx->aead_fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_aead_set_flags(ctx->aead_fallback, crypto_aead_get_flags(tfm) &
+						CRYPTO_TFM_REQ_MASK);
+
+	return crypto_aead_setkey(ctx->aead_fallback, key, len);
+}
+
+/* H is derived in software: setkey must not touch a unit the engine owns */
+static int deu_aead_gcm_key(struct deu_aes_ctx *ctx, const u8 *key,
+			unsigned int len)
+{
+	struct crypto_aes_ctx aes;
+	be128 h = {};
+	int err;
+
+	err = aes_expandkey(&aes, key, len);
+	if (err)
+		return err;
+
+	aes_encrypt(&aes, (u8 *)&h, (u8 *)&h);
+	memzero_explicit(&aes, sizeof(aes));
+
+	gf128mul_free_4k(ctx->ghash);
+	ctx->ghash = gf128mul_init_4k_lle(&h);
+	memzero_explicit(&h, sizeof(h));
+	if (!ctx->ghash)
+		return -ENOMEM;
+
+	return deu_aes_setkey(ctx, key, len);
+}
+
+static int deu_aead_gcm_setkey(struct crypto_aead *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	int err;
+
+	err = deu_aead_gcm_key(ctx, key, len);
+	if (err)
+		return err;
+
+	return deu_aead_fallback_setkey(tfm, key, len);
+}
+
+static int deu_aead_rfc4106_setkey(struct crypto_aead *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	unsigned int keylen;
+	int err;
+
+	if (len < 4)
+		return -EINVAL;
+
+	keylen = len - 4;
+	memcpy(&ctx->nonce, key + keylen, 4);
+
+	err = deu_aead_gcm_key(ctx, key, keylen);
+	if (err)
+		return err;
+
+	return deu_aead_fallback_setkey(tfm, key, len);
+}
+
+static int deu_aead_ccm_setkey(struct crypto_aead *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	int err;
+
+	err = deu_aes_setkey(ctx, key, len);
+	if (err)
+		return err;
+
+	return deu_aead_fallback_setkey(tfm, key, len);
+}
+
+static int deu_aead_rfc4309_setkey(struct crypto_aead *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	unsigned int keylen;
+	int err;
+
+	if (len < 3)
+		return -EINVAL;
+
+	keylen = len - 3;
+	memcpy(&ctx->nonce, key + keylen, 3);
+
+	err = deu_aes_setkey(ctx, key, keylen);
+	if (err)
+		return err;
+
+	return deu_aead_fallback_setkey(tfm, key, len);
+}
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+static int deu_aead_authenc_setkey(struct crypto_aead *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	struct crypto_authenc_keys keys;
+	int err;
+
+	err = crypto_authenc_extractkeys(&keys, key, len);
+	if (err)
+		goto out;
+
+	err = deu_aes_setkey(ctx, keys.enckey, keys.enckeylen);
+	if (err)
+		goto out;
+
+	err = deu_hmac_setkey(&ctx->hmac, HASH_ALGM_SHA1, keys.authkey,
+				keys.authkeylen);
+	if (err)
+		goto out;
+
+	err = deu_aead_fallback_setkey(tfm, key, len);
+
+out:
+	memzero_explicit(&keys, sizeof(keys));
+
+	return err;
+}
+
+static int deu_aead_authenc_setauthsize(struct crypto_aead *tfm,
+			unsigned int authsize)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+
+	return crypto_aead_setauthsize(ctx->aead_fallback, authsize);
+}
+#endif
+
+static int deu_aead_gcm_setauthsize(struct crypto_aead *tfm,
+			unsigned int authsize)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	int err;
+
+	err = crypto_gcm_check_authsize(authsize);
+	if (err)
+		return err;
+
+	return crypto_aead_setauthsize(ctx->aead_fallback, authsize);
+}
+
+static int deu_aead_rfc4106_setauthsize(struct crypto_aead *tfm,
+			unsigned int authsize)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	int err;
+
+	err = crypto_rfc4106_check_authsize(authsize);
+	if (err)
+		return err;
+
+	return crypto_aead_setauthsize(ctx->aead_fallback, authsize);
+}
+
+static int deu_aead_ccm_setauthsize(struct crypto_aead *tfm,
+			unsigned int authsize)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+
+	if (authsize < 4 || authsize > AES_BLOCK_SIZE || authsize & 1)
+		return -EINVAL;
+
+	return crypto_aead_setauthsize(ctx->aead_fallback, authsize);
+}
+
+static int deu_aead_rfc4309_setauthsize(struct crypto_aead *tfm,
+			unsigned int authsize)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+
+	switch (authsize) {
+	case 8:
+	case 12:
+	case 16:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return crypto_aead_setauthsize(ctx->aead_fallback, authsize);
+}
+
+static int deu_aead_fallback(struct aead_request *req, bool enc)
+{
+	struct deu_aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct deu_aead_reqctx *rctx = aead_request_ctx(req);
+	struct aead_request *subreq = &rctx->fallback_req;
+
+	aead_request_set_tfm(subreq, ctx->aead_fallback);
+	aead_request_set_callback(subreq, req->base.flags,
+				req->base.complete, req->base.data);
+	aead_request_set_crypt(subreq, req->src, req->dst,
+				req->cryptlen, req->iv);
+	aead_request_set_ad(subreq, req->assoclen);
+
+	return enc ? crypto_aead_encrypt(subreq) :
+			crypto_aead_decrypt(subreq);
+}
+
+static int deu_aead_do_one(struct crypto_engine *engine, void *areq)
+{
+	struct aead_request *req = container_of(areq, struct aead_request,
+						base);
+	struct deu_aead_reqctx *rctx = aead_request_ctx(req);
+	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.aead.base);
+	struct deu_unit *unit = engine->priv_data;
+	int err;
 
-	aes->CTRL.bits.K =  (keylen / 8) - 2;
+	deu_batch_flush(unit);
 
-	for (i = 0; i < keywords; i++)
-		keyreg[8 - keywords + i] = key[i];
+	switch (tmpl->mode) {
+	case MODE_CCM:
+	case MODE_RFC4309:
+		err = deu_aead_ccm_crypt(unit, req, tmpl->mode, rctx->enc);
+		break;
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+	case MODE_AUTHENC:
+		err = deu_aead_authenc_crypt(unit, req, rctx->enc);
+		break;
+#endif
+	default:
+		err = deu_aead_gcm_crypt(unit, req, tmpl->mode, rctx->enc);
+	}
 
-	 /* let HW pre-process DEcryption key in any case(even if
-	  * ENcryption is used). Key Valid(KV) bit is then only
-	 * checked in decryption routine!
-	 */
+	deu_put_unit(unit);
+	deu_stat_done(tmpl, rctx->queued, req->cryptlen, rctx->enc, err);
+	crypto_finalize_aead_request(engine, req, err);
 
-	 aes->CTRL.bits.PNK =  1;
+	return 0;
 }
 
-static void deu_transform_block(struct deu_aes_ctx *ctx, u32 *iv, u8 *out_arg,
-			const u8 *in_arg, size_t nbytes, int mode, bool enc)
+static int deu_aead_queue(struct aead_request *req, bool enc)
 {
-	struct aes_t *aes = (struct aes_t *)ltq_aes_membase;
-	union aes_control aesc;
-	const u32 *in = (u32 *)in_arg;
-	u32 *out = (u32 *)out_arg;
-	unsigned long flag;
-	int i = 0;
-
-	spin_lock_irqsave(&ltq_aes_lock, flag);
-
-	aes_set_key_hw(ctx);
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct deu_aead_reqctx *rctx = aead_request_ctx(req);
+	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.aead.base);
+	struct deu_unit *unit;
+	int err;
 
-	aes->CTRL.bits.E_D = !enc;
-	aes->CTRL.bits.O = mode;
+	if ((tmpl->mode == MODE_RFC4106 || tmpl->mode == MODE_RFC4309) &&
+			crypto_ipsec_check_assoclen(req->assoclen))
+		return -EINVAL;
 
-	if (iv) {
-		aes->IV3R = iv[0];
-		aes->IV2R = iv[1];
-		aes->IV1R = iv[2];
-		aes->IV0R = iv[3];
-	};
+	/* L' in the first IV byte must be 1..7 */
+	if (tmpl->mode == MODE_CCM && (req->iv[0] < 1 || req->iv[0] > 7))
+		return -EINVAL;
 
-	while (nbytes) {
-		aes->ID3R = in[i + 0];
-		aes->ID2R = in[i + 1];
-		aes->ID1R = in[i + 2];
-		aes->ID0R = in[i + 3];
+	if (!enc && req->cryptlen < crypto_aead_authsize(tfm))
+		return -EINVAL;
 
-		do {
-			aesc.word = __raw_readl(ltq_aes_membase);
-		} while (aesc.bits.BUS);
+	/* the unit only does whole CBC blocks, the fallback decides the rest */
+	if (tmpl->mode == MODE_AUTHENC &&
+	    (req->cryptlen - (enc ? 0 : crypto_aead_authsize(tfm))) %
+			AES_BLOCK_SIZE)
+		return deu_aead_fallback(req, enc);
 
-		out[i + 0] = aes->OD3R;
-		out[i + 1] = aes->OD2R;
-		out[i + 2] = aes->OD1R;
-		out[i + 3] = aes->OD0R;
+	unit = deu_claim_engine(DEU_UNIT_AES, tmpl, req->cryptlen, enc);
+	if (!unit)
+		return deu_aead_fallback(req, enc);
 
-		nbytes -= AES_BLOCK_SIZE;
-		i += (AES_BLOCK_SIZE / 4);
-	}
+	rctx->enc = enc;
+	rctx->queued = ktime_get_ns();
 
-	if (iv) {
-		iv[0] = aes->IV3R;
-		iv[1] = aes->IV2R;
-		iv[2] = aes->IV1R;
-		iv[3] = aes->IV0R;
-	}
+	err = crypto_transfer_aead_request_to_engine(unit->engine,
+						req);
+	if (err == -ENOSPC)
+		deu_put_unit(unit);
 
-	spin_unlock_irqrestore(&ltq_aes_lock, flag);
+	return err;
 }
 
-static void deu_aes_xts_transform(struct deu_aes_ctx *ctx, u32 *iv, u8 *out_arg,
-			const u8 *in_arg, size_t nbytes, bool enc)
+static int deu_aead_encrypt(struct aead_request *req)
 {
-    	struct aes_t *aes = (struct aes_t *)ltq_aes_membase;
-	union aes_control aesc;
-	const u32 *in = (u32 *)in_arg;
-	u32 *out = (u32 *)out_arg;
-        unsigned long flag;
-	u32 saveiv[AES_BLOCK_SIZE / 4];
-	u32 state[XTS_BLOCK_SIZE / 4];
-	int i = 0, j;
-	int byte_cnt = nbytes;
-
-	spin_lock_irqsave(&ltq_aes_lock, flag);
+	return deu_aead_queue(req, true);
+}
 
-	aes_set_key_hw (ctx);
+static int deu_aead_decrypt(struct aead_request *req)
+{
+	return deu_aead_queue(req, false);
+}
 
-	aes->CTRL.bits.E_D = !enc;
-	aes->CTRL.bits.O = MODE_CBC;
+static int deu_aead_init_tfm(struct crypto_aead *tfm)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(crypto_aead_tfm(tfm));
 
-	while (byte_cnt >= AES_BLOCK_SIZE) {
-		if (!enc) {
-			if (((byte_cnt % AES_BLOCK_SIZE) > 0) &&
-					(byte_cnt < (2 * XTS_BLOCK_SIZE))) {
-				memcpy(saveiv, iv, AES_BLOCK_SIZE);
-				gf128mul_x_ble((le128 *)iv, (le128 *)iv);
-			}
-			u128_xor((u128 *)&in[i], (u128 *)&in[i], (u128 *)iv);
-		}
+	ctx->aead_fallback = crypto_alloc_aead(name, 0, CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->aead_fallback))
+		return PTR_ERR(ctx->aead_fallback);
 
-		aes->IV3R = iv[0];
-		aes->IV2R = iv[1];
-		aes->IV1R = iv[2];
-		aes->IV0R = iv[3];
+	crypto_aead_set_reqsize(tfm, sizeof(struct deu_aead_reqctx) +
+				crypto_aead_reqsize(ctx->aead_fallback));
 
-		aes->ID3R = in[i + 0];
-		aes->ID2R = in[i + 1];
-		aes->ID1R = in[i + 2];
-		aes->ID0R = in[i + 3];
+	ctx->tmpl = container_of(crypto_aead_alg(tfm),
+				struct deu_alg_template, alg.aead);
+	ctx->enginectx.op.do_one_request = deu_aead_do_one;
+	ctx->enginectx.op.prepare_request = NULL;
+	ctx->enginectx.op.unprepare_request = NULL;
 
-		do {
-			aesc.word = __raw_readl(ltq_aes_membase);
-		} while (aesc.bits.BUS);
+	return 0;
+}
 
-		out[i + 0] = aes->OD3R;
-		out[i + 1] = aes->OD2R;
-		out[i + 2] = aes->OD1R;
-		out[i + 3] = aes->OD0R;
+static void deu_aead_exit_tfm(struct crypto_aead *tfm)
+{
+	struct deu_aes_ctx *ctx = crypto_aead_ctx(tfm);
 
-        	if (enc)
-			u128_xor((u128 *)&out[i], (u128 *)&out[i], (u128 *)iv);
+	gf128mul_free_4k(ctx->ghash);
+	crypto_free_aead(ctx->aead_fallback);
+}
 
-		gf128mul_x_ble((le128 *)iv, (le128 *)iv);
-		i += (AES_BLOCK_SIZE / 4);
-		byte_cnt -= AES_BLOCK_SIZE;
-	}
+static int deu_cbcmac_setkey(struct crypto_shash *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_mac_ctx *ctx = crypto_shash_ctx(tfm);
+	int err;
 
-	if (byte_cnt) {
-		j = i - 4;
+	err = aes_expandkey(&ctx->sw, key, len);
+	if (err)
+		return err;
 
-		if (!enc)
-			memcpy(iv, saveiv, AES_BLOCK_SIZE);
+	ctx->aes.tmpl = container_of(crypto_shash_alg(tfm),
+				struct deu_alg_template, alg.shash);
 
-		aes->IV3R = iv[0];
-		aes->IV2R = iv[1];
-		aes->IV1R = iv[2];
-		aes->IV0R = iv[3];
+	return deu_aes_setkey(&ctx->aes, key, len);
+}
 
-		memcpy(state, &out[j], AES_BLOCK_SIZE);
-      		memcpy(state, &in[i], byte_cnt);
-		if (!enc)
-			u128_xor((u128 *)state, (u128 *)state, (u128 *)iv);
+/* K1 and K2 are L = E(0) doubled once and twice in GF(2^128) */
+static int deu_cmac_setkey(struct crypto_shash *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_mac_ctx *ctx = crypto_shash_ctx(tfm);
+	__be64 *consts = (__be64 *)ctx->consts;
+	u64 a, b, carry;
+	int err, i;
 
-		aes->ID3R = state[0];
-		aes->ID2R = state[1];
-		aes->ID1R = state[2];
-		aes->ID0R = state[3];
+	err = deu_cbcmac_setkey(tfm, key, len);
+	if (err)
+		return err;
 
-		memcpy(&out[i], &out[j], byte_cnt);
+	memset(ctx->consts, 0, AES_BLOCK_SIZE);
+	aes_encrypt(&ctx->sw, ctx->consts, ctx->consts);
 
-		do {
-			aesc.word = __raw_readl(ltq_aes_membase);
-		} while (aesc.bits.BUS);
+	a = be64_to_cpu(consts[0]);
+	b = be64_to_cpu(consts[1]);
 
-		out[j + 0] = aes->OD3R;
-		out[j + 1] = aes->OD2R;
-		out[j + 2] = aes->OD1R;
-		out[j + 3] = aes->OD0R;
+	for (i = 0; i < 2; i++) {
+		carry = a >> 63;
+		a = (a << 1) | (b >> 63);
+		b = (b << 1) ^ (carry ? 0x87 : 0);
 
-		if (enc)
-			u128_xor((u128 *)&out[j], (u128 *)&out[j], (u128 *)iv);
+		consts[2 * i + 0] = cpu_to_be64(a);
+		consts[2 * i + 1] = cpu_to_be64(b);
 	}
 
-	spin_unlock_irqrestore(&ltq_aes_lock, flag);
+	return 0;
 }
 
-static int deu_skcipher_crypt(struct skcipher_request *req, int mode, bool enc)
+/* RFC 3566: the MAC runs under K1 = E(0x01..), K2/K3 tweak the last block */
+static int deu_xcbc_setkey(struct crypto_shash *tfm, const u8 *key,
+			unsigned int len)
 {
-	struct deu_aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct skcipher_walk walk;
-	unsigned int blk_bytes, nbytes;
-	u32 *iv = NULL;
-	u32 rfc3686iv[AES_BLOCK_SIZE / 4];
+	struct deu_mac_ctx *ctx = crypto_shash_ctx(tfm);
+	u8 k1[AES_BLOCK_SIZE];
 	int err;
 
-	err = skcipher_walk_virt(&walk, req, false);
-
-	if (mode > 0)
-		iv = (u32 *)walk.iv;
-
-	if (mode == MODE_RFC3686) {
-		rfc3686iv[0] = ctx->nonce;
-		rfc3686iv[1] = iv[0];
-		rfc3686iv[2] = iv[1];
-		rfc3686iv[3] = cpu_to_be32(1);
-		iv = rfc3686iv;
-		mode = MODE_CTR;
-	}
-
-	while ((nbytes = blk_bytes = walk.nbytes) &&
-					(walk.nbytes >= AES_BLOCK_SIZE)) {
-		blk_bytes -= (nbytes % AES_BLOCK_SIZE);
-
-		deu_transform_block(ctx, iv, walk.dst.virt.addr,
-				walk.src.virt.addr, blk_bytes, mode, enc);
-		nbytes &= AES_BLOCK_SIZE - 1;
-		err = skcipher_walk_done(&walk, nbytes);
-	}
-	/* For stream ciphers handle last block
-	 * less than AES_BLOCK_SIZE (ofb, cfb and ctr)
-	 */
-	if (walk.nbytes) {
-		u8 buf[AES_BLOCK_SIZE];
+	err = aes_expandkey(&ctx->sw, key, len);
+	if (err)
+		return err;
 
-		memcpy(&buf, walk.src.virt.addr, nbytes);
-		deu_transform_block(ctx, iv, buf, buf,
-						AES_BLOCK_SIZE, mode, enc);
+	memset(k1, 0x01, AES_BLOCK_SIZE);
+	aes_encrypt(&ctx->sw, k1, k1);
+	memset(ctx->consts, 0x02, AES_BLOCK_SIZE);
+	aes_encrypt(&ctx->sw, ctx->consts, ctx->consts);
+	memset(ctx->consts + AES_BLOCK_SIZE, 0x03, AES_BLOCK_SIZE);
+	aes_encrypt(&ctx->sw, ctx->consts + AES_BLOCK_SIZE,
+			ctx->consts + AES_BLOCK_SIZE);
 
-		memcpy(walk.dst.virt.addr, &buf, nbytes);
-		err = skcipher_walk_done(&walk, 0);
-	}
+	err = deu_cbcmac_setkey(tfm, k1, AES_KEYSIZE_128);
+	memzero_explicit(k1, sizeof(k1));
 
 	return err;
 }
 
-static int deu_aes_xts_crypt(struct skcipher_request *req, bool enc)
+static int deu_mac_init(struct shash_desc *desc)
 {
-	struct deu_aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct skcipher_walk walk;
-	u32 *iv = NULL;
-	unsigned int blk_bytes, nbytes, processed = 0;
-	int err;
-
-	err = skcipher_walk_virt(&walk, req, false);
+	struct deu_mac_desc_ctx *dctx = shash_desc_ctx(desc);
 
-	if (req->cryptlen < XTS_BLOCK_SIZE)
-		return -EINVAL;
+	memset(dctx, 0, sizeof(*dctx));
 
-	ctx->use_tweak = true;
-	deu_transform_block(ctx, iv, walk.iv, walk.iv, AES_BLOCK_SIZE, 0, true);
-	ctx->use_tweak = false;
+	return 0;
+}
 
-	iv = (u32 *)walk.iv;
+static int deu_mac_update(struct shash_desc *desc, const u8 *p,
+			unsigned int len)
+{
+	struct deu_mac_ctx *ctx = crypto_shash_ctx(desc->tfm);
+	struct deu_mac_desc_ctx *dctx = shash_desc_ctx(desc);
+	struct deu_unit *unit;
+	unsigned int n;
+	int err = 0;
+
+	unit = deu_get_unit(DEU_UNIT_AES);
+	if (unit)
+		deu_stat_request(unit, ctx->aes.tmpl, len, DEU_OP_HASH);
+
+	if (dctx->len + len <= AES_BLOCK_SIZE) {
+		memcpy(dctx->buf + dctx->len, p, len);
+		dctx->len += len;
+		goto out;
+	}
 
-    	while ((nbytes = walk.nbytes)
-				&& (walk.nbytes >= (XTS_BLOCK_SIZE * 2)) ) {
-		if (nbytes == walk.total) {
-			blk_bytes = nbytes;
-		} else {
-			blk_bytes = nbytes & ~(XTS_BLOCK_SIZE - 1);
+	if (dctx->len) {
+		n = AES_BLOCK_SIZE - dctx->len;
+		memcpy(dctx->buf + dctx->len, p, n);
+		err = deu_mac_transform(unit, ctx, dctx->dg, dctx->buf,
+					AES_BLOCK_SIZE);
+		if (err)
+			goto out;
+		p += n;
+		len -= n;
+	}
 
-			if ((req->cryptlen - processed - blk_bytes) <
-							(XTS_BLOCK_SIZE)) {
-				if (blk_bytes > (2 * XTS_BLOCK_SIZE)) {
-					blk_bytes -= XTS_BLOCK_SIZE;
-				} else {
-					break;
-				}
-			}
-		}
-		deu_aes_xts_transform(ctx, iv, walk.dst.virt.addr,
-			walk.src.virt.addr, blk_bytes, enc);
-		err = skcipher_walk_done(&walk, nbytes - blk_bytes);
-		processed += blk_bytes;
+	/* keep 1..16 bytes back, final may have to tweak them */
+	n = (len - 1) & ~(AES_BLOCK_SIZE - 1);
+	if (n) {
+		err = deu_mac_transform(unit, ctx, dctx->dg, p, n);
+		if (err)
+			goto out;
+		p += n;
+		len -= n;
 	}
 
-	if ((walk.nbytes)) {
-		nbytes = req->cryptlen - processed;
+	memcpy(dctx->buf, p, len);
+	dctx->len = len;
 
-		scatterwalk_map_and_copy(ctx->lastbuffer, req->src,
-					(req->cryptlen - nbytes), nbytes, 0);
-		deu_aes_xts_transform(ctx, iv, ctx->lastbuffer,
-					ctx->lastbuffer, nbytes, enc);
-        	scatterwalk_map_and_copy(ctx->lastbuffer, req->dst,
-					(req->cryptlen - nbytes), nbytes, 1);
-		skcipher_request_complete(req, 0);
-	}
+out:
+	if (unit)
+		deu_put_unit(unit);
 
 	return err;
 }
 
-/* Crypto API */
-static int deu_skcipher_setkey(struct crypto_skcipher *tfm, const u8 *key,
-			unsigned int len)
+static int deu_mac_final(struct shash_desc *desc, u8 *out)
 {
-	struct crypto_tfm *ctfm = crypto_skcipher_tfm(tfm);
-	struct deu_aes_ctx *ctx = crypto_tfm_ctx(ctfm);
+	struct deu_mac_ctx *ctx = crypto_shash_ctx(desc->tfm);
+	struct deu_mac_desc_ctx *dctx = shash_desc_ctx(desc);
+	struct deu_alg_template *tmpl = container_of(crypto_shash_alg(desc->tfm),
+				struct deu_alg_template, alg.shash);
+	u8 *consts = ctx->consts;
+	struct deu_unit *unit;
+	int err;
 
-	switch (len) {
-	case AES_KEYSIZE_128:
-	case AES_KEYSIZE_192:
-	case AES_KEYSIZE_256:
-		break;
-	default:
-		return -EINVAL;
+	if (tmpl->mode == MODE_CBCMAC) {
+		/* zero padded, like crypto/ccm.c */
+		if (!dctx->len)
+			goto out;
+		memset(dctx->buf + dctx->len, 0, AES_BLOCK_SIZE - dctx->len);
+	} else {
+		if (dctx->len < AES_BLOCK_SIZE) {
+			dctx->buf[dctx->len] = 0x80;
+			memset(dctx->buf + dctx->len + 1, 0,
+				AES_BLOCK_SIZE - dctx->len - 1);
+			consts += AES_BLOCK_SIZE;
+		}
+		crypto_xor(dctx->buf, consts, AES_BLOCK_SIZE);
 	}
 
-	ctx->keylen = len;
-	ctx->use_tweak = false;
-	memcpy(&ctx->key, key, len);
+	unit = deu_get_unit(DEU_UNIT_AES);
+	err = deu_mac_transform(unit, ctx, dctx->dg, dctx->buf, AES_BLOCK_SIZE);
+	if (unit)
+		deu_put_unit(unit);
+	if (err)
+		return err;
+
+out:
+	memcpy(out, dctx->dg, AES_BLOCK_SIZE);
 
 	return 0;
 }
 
-static int deu_skcipher_rfc3686_setkey(struct crypto_skcipher *tfm,
-				const u8 *key, unsigned int len)
+static int deu_skcipher_do_one(struct crypto_engine *engine, void *areq)
 {
-	struct crypto_tfm *ctfm = crypto_skcipher_tfm(tfm);
-	struct deu_aes_ctx *ctx = crypto_tfm_ctx(ctfm);
+	struct skcipher_request *req = skcipher_request_cast(areq);
+	struct deu_aes_reqctx *rctx = skcipher_request_ctx(req);
+	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.skcipher.base);
+	struct deu_unit *unit = engine->priv_data;
+	int err;
 
-	if (!key || !len)
-		return -EINVAL;
+	/* small PIO requests share one unit session with their neighbours */
+	if (tmpl->mode != MODE_XTS &&
+	    req->cryptlen <= deu_chunk_blocks() * AES_BLOCK_SIZE &&
+	    !deu_dma_capable(unit, req->src, req->dst, req->cryptlen,
+				AES_BLOCK_SIZE)) {
+		/*
+		 * Walked with the unit lock held, so through a copy that
+		 * must not sleep; the caller's flags stay as they are. The
+		 * fallback request is free, a queued request never uses it.
+		 */
+		skcipher_request_set_tfm(&rctx->fallback_req,
+					crypto_skcipher_reqtfm(req));
+		skcipher_request_set_callback(&rctx->fallback_req,
+				req->base.flags & ~CRYPTO_TFM_REQ_MAY_SLEEP,
+				NULL, NULL);
+		skcipher_request_set_crypt(&rctx->fallback_req, req->src,
+				req->dst, req->cryptlen, req->iv);
+		return deu_batch_add(unit, &req->base,
+					deu_aes_batch_run);
+	}
 
-	if (len < CTR_RFC3686_NONCE_SIZE)
-		return -EINVAL;
+	deu_batch_flush(unit);
+
+	if (tmpl->mode == MODE_XTS)
+		err = deu_aes_xts_crypt(unit, req, rctx->enc);
+	else
+		err = deu_skcipher_crypt(unit, req, tmpl->mode, rctx->enc);
 
-	len -= CTR_RFC3686_NONCE_SIZE;
-	memcpy(&ctx->nonce, key + len, CTR_RFC3686_NONCE_SIZE);
+	deu_put_unit(unit);
+	deu_stat_done(tmpl, rctx->queued, req->cryptlen, rctx->enc, err);
+	crypto_finalize_skcipher_request(engine, req, err);
 
-	return deu_skcipher_setkey(tfm, key, len);
+	return 0;
 }
 
-static int deu_skcipher_xts_setkey(struct crypto_skcipher *tfm,
-				const u8 *key, unsigned int keylen)
+static int deu_skcipher_queue(struct skcipher_request *req, bool enc)
 {
-	struct deu_aes_ctx *ctx = crypto_tfm_ctx(crypto_skcipher_tfm(tfm));
-	unsigned int len = (keylen / 2);
+	struct deu_aes_reqctx *rctx = skcipher_request_ctx(req);
+	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.skcipher.base);
+	struct deu_unit *unit;
+	int err;
 
-	if (keylen % 2)
+	if (tmpl->mode == MODE_XTS && req->cryptlen < XTS_BLOCK_SIZE)
 		return -EINVAL;
 
-	memcpy(&ctx->tweakkey, key + len, len);
+	unit = deu_claim_engine(DEU_UNIT_AES, tmpl, req->cryptlen, enc);
+	if (!unit)
+		return deu_skcipher_fallback(req, enc);
+
+	rctx->enc = enc;
+	rctx->queued = ktime_get_ns();
+
+	err = crypto_transfer_skcipher_request_to_engine(unit->engine,
+						req);
+	if (err == -ENOSPC)
+		deu_put_unit(unit);
 
-	return deu_skcipher_setkey(tfm, key, len);
+	return err;
 }
 
 static int deu_skcipher_encrypt(struct skcipher_request *req)
 {
-	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
-				struct deu_alg_template, alg.skcipher.base);
-
-	if (tmpl->mode == MODE_XTS)
-		return deu_aes_xts_crypt(req, true);
-
-	return deu_skcipher_crypt(req, tmpl->mode, true);
+	return deu_skcipher_queue(req, true);
 }
 
 static int deu_skcipher_decrypt(struct skcipher_request *req)
 {
-	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
-			struct deu_alg_template, alg.skcipher.base);
+	return deu_skcipher_queue(req, false);
+}
 
-	if (tmpl->mode == MODE_XTS)
-		return deu_aes_xts_crypt(req, false);
+static int deu_skcipher_init_tfm(struct crypto_skcipher *tfm)
+{
+	struct deu_aes_ctx *ctx = crypto_skcipher_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(crypto_skcipher_tfm(tfm));
+
+	ctx->fallback = crypto_alloc_skcipher(name, 0, CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		return PTR_ERR(ctx->fallback);
+
+	ctx->tmpl = container_of(crypto_skcipher_alg(tfm),
+				struct deu_alg_template, alg.skcipher);
+
+	/* only XTS carries the tweak scratch */
+	if (ctx->tmpl->mode == MODE_XTS)
+		crypto_skcipher_set_reqsize(tfm, deu_aes_xts_offset(ctx) +
+				sizeof(struct deu_aes_xts_reqctx));
+	else
+		crypto_skcipher_set_reqsize(tfm,
+				sizeof(struct deu_aes_reqctx) +
+				crypto_skcipher_reqsize(ctx->fallback));
+	ctx->enginectx.op.do_one_request = deu_skcipher_do_one;
+	ctx->enginectx.op.prepare_request = NULL;
+	ctx->enginectx.op.unprepare_request = NULL;
+
+	return 0;
+}
+
+static void deu_skcipher_exit_tfm(struct crypto_skcipher *tfm)
+{
+	struct deu_aes_ctx *ctx = crypto_skcipher_ctx(tfm);
 
-	return deu_skcipher_crypt(req, tmpl->mode, false);
+	crypto_free_skcipher(ctx->fallback);
 }
 
 struct deu_alg_template deu_alg_ecb_aes = {
@@ -410,6 +2002,8 @@ struct deu_alg_template deu_alg_ecb_aes = {
 		.setkey = deu_skcipher_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = AES_MIN_KEY_SIZE,
 		.max_keysize = AES_MAX_KEY_SIZE,
 		.ivsize = 0,
@@ -418,6 +2012,8 @@ struct deu_alg_template deu_alg_ecb_aes = {
 			.cra_driver_name = "ecb(aes-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = AES_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct deu_aes_ctx),
@@ -434,6 +2030,8 @@ struct deu_alg_template deu_alg_cbc_aes = {
 		.setkey = deu_skcipher_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = AES_MIN_KEY_SIZE,
 		.max_keysize = AES_MAX_KEY_SIZE,
 		.ivsize = AES_BLOCK_SIZE,
@@ -442,10 +2040,12 @@ struct deu_alg_template deu_alg_cbc_aes = {
 			.cra_driver_name = "cbc(aes-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = AES_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct deu_aes_ctx),
-			.cra_alignmask = 0xf,
+			.cra_alignmask = 0,
 			.cra_module = THIS_MODULE,
 		},
 	},
@@ -458,6 +2058,8 @@ struct deu_alg_template deu_alg_ofb_aes = {
 		.setkey = deu_skcipher_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = AES_MIN_KEY_SIZE,
 		.max_keysize = AES_MAX_KEY_SIZE,
 		.chunksize = AES_BLOCK_SIZE,
@@ -468,6 +2070,8 @@ struct deu_alg_template deu_alg_ofb_aes = {
 			.cra_driver_name = "ofb(aes-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_aes_ctx),
@@ -484,6 +2088,8 @@ struct deu_alg_template deu_alg_cfb_aes = {
 		.setkey = deu_skcipher_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = AES_MIN_KEY_SIZE,
 		.max_keysize = AES_MAX_KEY_SIZE,
 		.chunksize = AES_BLOCK_SIZE,
@@ -494,6 +2100,8 @@ struct deu_alg_template deu_alg_cfb_aes = {
 			.cra_driver_name = "cfb(aes-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_aes_ctx),
@@ -510,6 +2118,8 @@ struct deu_alg_template deu_alg_ctr_aes = {
 		.setkey = deu_skcipher_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = AES_MIN_KEY_SIZE,
 		.max_keysize = AES_MAX_KEY_SIZE,
 		.chunksize = AES_BLOCK_SIZE,
@@ -519,10 +2129,12 @@ struct deu_alg_template deu_alg_ctr_aes = {
 			.cra_driver_name = "ctr(aes-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_aes_ctx),
-			.cra_alignmask = 1,
+			.cra_alignmask = 0,
 			.cra_module = THIS_MODULE,
 		},
 	},
@@ -535,6 +2147,8 @@ struct deu_alg_template deu_alg_rfc3686_aes = {
 		.setkey = deu_skcipher_rfc3686_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = AES_MIN_KEY_SIZE + CTR_RFC3686_NONCE_SIZE,
 		.max_keysize = AES_MAX_KEY_SIZE + CTR_RFC3686_NONCE_SIZE,
 		.chunksize = AES_BLOCK_SIZE,
@@ -544,10 +2158,12 @@ struct deu_alg_template deu_alg_rfc3686_aes = {
 			.cra_driver_name = "rfc3686(ctr(aes-deu))",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_aes_ctx),
-			.cra_alignmask = 1,
+			.cra_alignmask = 0,
 			.cra_module = THIS_MODULE,
 		},
 	},
@@ -560,6 +2176,8 @@ struct deu_alg_template deu_alg_xts_aes = {
 		.setkey = deu_skcipher_xts_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = AES_MIN_KEY_SIZE * 2,
 		.max_keysize = AES_MAX_KEY_SIZE * 2,
 		.walksize = XTS_BLOCK_SIZE * 2,
@@ -569,6 +2187,8 @@ struct deu_alg_template deu_alg_xts_aes = {
 			.cra_driver_name = "xts(aes-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = XTS_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct deu_aes_ctx),
@@ -577,3 +2197,221 @@ struct deu_alg_template deu_alg_xts_aes = {
 		},
 	},
 };
+
+struct deu_alg_template deu_alg_gcm_aes = {
+	.type = DEU_ALG_TYPE_AEAD,
+	.mode = MODE_GCM,
+	.alg.aead = {
+		.setkey = deu_aead_gcm_setkey,
+		.setauthsize = deu_aead_gcm_setauthsize,
+		.encrypt = deu_aead_encrypt,
+		.decrypt = deu_aead_decrypt,
+		.init = deu_aead_init_tfm,
+		.exit = deu_aead_exit_tfm,
+		.ivsize = GCM_AES_IV_SIZE,
+		.maxauthsize = AES_BLOCK_SIZE,
+		.chunksize = AES_BLOCK_SIZE,
+		.base = {
+			.cra_name = "gcm(aes)",
+			.cra_driver_name = "gcm(aes-deu)",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_AEAD |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = 1,
+			.cra_ctxsize = sizeof(struct deu_aes_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_rfc4106_aes = {
+	.type = DEU_ALG_TYPE_AEAD,
+	.mode = MODE_RFC4106,
+	.alg.aead = {
+		.setkey = deu_aead_rfc4106_setkey,
+		.setauthsize = deu_aead_rfc4106_setauthsize,
+		.encrypt = deu_aead_encrypt,
+		.decrypt = deu_aead_decrypt,
+		.init = deu_aead_init_tfm,
+		.exit = deu_aead_exit_tfm,
+		.ivsize = GCM_RFC4106_IV_SIZE,
+		.maxauthsize = AES_BLOCK_SIZE,
+		.chunksize = AES_BLOCK_SIZE,
+		.base = {
+			.cra_name = "rfc4106(gcm(aes))",
+			.cra_driver_name = "rfc4106(gcm(aes-deu))",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_AEAD |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = 1,
+			.cra_ctxsize = sizeof(struct deu_aes_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_ccm_aes = {
+	.type = DEU_ALG_TYPE_AEAD,
+	.mode = MODE_CCM,
+	.alg.aead = {
+		.setkey = deu_aead_ccm_setkey,
+		.setauthsize = deu_aead_ccm_setauthsize,
+		.encrypt = deu_aead_encrypt,
+		.decrypt = deu_aead_decrypt,
+		.init = deu_aead_init_tfm,
+		.exit = deu_aead_exit_tfm,
+		.ivsize = AES_BLOCK_SIZE,
+		.maxauthsize = AES_BLOCK_SIZE,
+		.chunksize = AES_BLOCK_SIZE,
+		.base = {
+			.cra_name = "ccm(aes)",
+			.cra_driver_name = "ccm(aes-deu)",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_AEAD |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = 1,
+			.cra_ctxsize = sizeof(struct deu_aes_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_rfc4309_aes = {
+	.type = DEU_ALG_TYPE_AEAD,
+	.mode = MODE_RFC4309,
+	.alg.aead = {
+		.setkey = deu_aead_rfc4309_setkey,
+		.setauthsize = deu_aead_rfc4309_setauthsize,
+		.encrypt = deu_aead_encrypt,
+		.decrypt = deu_aead_decrypt,
+		.init = deu_aead_init_tfm,
+		.exit = deu_aead_exit_tfm,
+		.ivsize = 8,
+		.maxauthsize = AES_BLOCK_SIZE,
+		.chunksize = AES_BLOCK_SIZE,
+		.base = {
+			.cra_name = "rfc4309(ccm(aes))",
+			.cra_driver_name = "rfc4309(ccm(aes-deu))",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_AEAD |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = 1,
+			.cra_ctxsize = sizeof(struct deu_aes_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+struct deu_alg_template deu_alg_authenc_sha1_cbc_aes = {
+	.type = DEU_ALG_TYPE_AEAD,
+	.mode = MODE_AUTHENC,
+	.alg.aead = {
+		.setkey = deu_aead_authenc_setkey,
+		.setauthsize = deu_aead_authenc_setauthsize,
+		.encrypt = deu_aead_encrypt,
+		.decrypt = deu_aead_decrypt,
+		.init = deu_aead_init_tfm,
+		.exit = deu_aead_exit_tfm,
+		.ivsize = AES_BLOCK_SIZE,
+		.maxauthsize = SHA1_DIGEST_SIZE,
+		.base = {
+			.cra_name = "authenc(hmac(sha1),cbc(aes))",
+			.cra_driver_name = "authenc(hmac(sha1-deu),cbc(aes-deu))",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_AEAD |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = AES_BLOCK_SIZE,
+			.cra_ctxsize = sizeof(struct deu_aes_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+#endif
+
+struct deu_alg_template deu_alg_cbcmac_aes = {
+	.type = DEU_ALG_TYPE_SHASH,
+	.mode = MODE_CBCMAC,
+	.alg.shash = {
+		.init = deu_mac_init,
+		.update = deu_mac_update,
+		.final = deu_mac_final,
+		.setkey = deu_cbcmac_setkey,
+		.descsize = sizeof(struct deu_mac_desc_ctx),
+		.digestsize = AES_BLOCK_SIZE,
+		.base = {
+			.cra_name = "cbcmac(aes)",
+			.cra_driver_name = "cbcmac(aes-deu)",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_SHASH |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = 1,
+			.cra_ctxsize = sizeof(struct deu_mac_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_cmac_aes = {
+	.type = DEU_ALG_TYPE_SHASH,
+	.mode = MODE_CMAC,
+	.alg.shash = {
+		.init = deu_mac_init,
+		.update = deu_mac_update,
+		.final = deu_mac_final,
+		.setkey = deu_cmac_setkey,
+		.descsize = sizeof(struct deu_mac_desc_ctx),
+		.digestsize = AES_BLOCK_SIZE,
+		.base = {
+			.cra_name = "cmac(aes)",
+			.cra_driver_name = "cmac(aes-deu)",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_SHASH |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = AES_BLOCK_SIZE,
+			.cra_ctxsize = sizeof(struct deu_mac_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_xcbc_aes = {
+	.type = DEU_ALG_TYPE_SHASH,
+	.mode = MODE_XCBC,
+	.alg.shash = {
+		.init = deu_mac_init,
+		.update = deu_mac_update,
+		.final = deu_mac_final,
+		.setkey = deu_xcbc_setkey,
+		.descsize = sizeof(struct deu_mac_desc_ctx),
+		.digestsize = AES_BLOCK_SIZE,
+		.base = {
+			.cra_name = "xcbc(aes)",
+			.cra_driver_name = "xcbc(aes-deu)",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_SHASH |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = AES_BLOCK_SIZE,
+			.cra_ctxsize = sizeof(struct deu_mac_ctx),
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
@@ -17,9 +17,16 @@
 #ifndef _DEU_AES_H_
 #define _DEU_AES_H_
 
+#include <crypto/aead.h>
 #include <crypto/aes.h>
+#include <crypto/engine.h>
+#include <crypto/gf128mul.h>
 #include <crypto/xts.h>
 
+#include "deu-hash.h"
+
+#define DEU_AES_BASE	0x50
+
 #define MODE_ECB	0
 #define MODE_CBC	1
 #define MODE_OFB	2
@@ -27,6 +34,14 @@
 #define MODE_CTR	4
 #define MODE_RFC3686	5	// Software mode
 #define MODE_XTS	6	// Software mode
+#define MODE_GCM	7	// Software mode
+#define MODE_RFC4106	8	// Software mode
+#define MODE_CCM	9	// Software mode
+#define MODE_RFC4309	10	// Software mode
+#define MODE_AUTHENC	11	// Software mode
+#define MODE_CBCMAC	12	// Software mode
+#define MODE_CMAC	13	// Software mode
+#define MODE_XCBC	14	// Software mode
 
 union aes_control {
 	u32	word;
@@ -77,20 +92,54 @@ struct aes_t {
 };
 
 struct deu_aes_ctx {
+	struct crypto_engine_ctx enginectx;
+	struct deu_alg_template	*tmpl;
 	int			keylen;
+	u32			key_gen;
 	u32			key[AES_MAX_KEY_SIZE / 4];
 	u32		 	nonce;
 	u32			tweakkey[AES_MAX_KEY_SIZE / 4];
+	struct crypto_skcipher	*fallback;
+	struct crypto_aead	*aead_fallback;
+	struct gf128mul_4k	*ghash;
+	struct deu_hmac_key	hmac;
+};
+
+/* XTS blocks whose tweaks are precomputed and XORed in one go */
+#define DEU_XTS_BATCH		32
+
+struct deu_aes_reqctx {
+	bool			enc;
+	u64			queued;		/* ktime_get_ns() */
+	struct skcipher_request	fallback_req;	// keep at the end
+};
+
+/* xts(aes) requests only, behind the fallback request's context */
+struct deu_aes_xts_reqctx {
+	le128			tweaks[DEU_XTS_BATCH];
 	u8			lastbuffer[4 * XTS_BLOCK_SIZE];
-	bool			use_tweak;
-	u32			byte_count;
-	u32			dbn;
-	int			started;
-	u32			(*temp)[AES_BLOCK_SIZE / 4];
-	u8			block[AES_BLOCK_SIZE];
-	u8			hash[AES_BLOCK_SIZE];
 };
 
-void aes_init_hw(__iomem void *base);
+struct deu_aead_reqctx {
+	bool			enc;
+	u64			queued;		/* ktime_get_ns() */
+	struct aead_request	fallback_req;	// keep at the end
+};
+
+/* cbcmac, cmac and xcbc: K1/K2 (cmac) or K2/K3 (xcbc) in consts */
+struct deu_mac_ctx {
+	struct deu_aes_ctx	aes;
+	struct crypto_aes_ctx	sw;
+	u8			consts[2 * AES_BLOCK_SIZE];
+};
+
+/* The last block is held back in buf until final */
+struct deu_mac_desc_ctx {
+	unsigned int		len;
+	u32			dg[AES_BLOCK_SIZE / 4];
+	u8			buf[AES_BLOCK_SIZE];
+};
+
+void aes_init_hw(struct deu_unit *unit, __iomem void *base);
 
 #endif /* _DEU_AES_H_ */
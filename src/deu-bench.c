@@ -0,0 +1,586 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Benchmark for the Data Encryption Unit driver
+ *
+ * Runs every algorithm ltq-crypto registered, for each key size it
+ * accepts, through encrypt and decrypt (or digest) of 16 bytes to 16 KB
+ * split over 1 to max_sg scatterlist entries. Requests go through the
+ * crypto API by driver name, so software fallback, batching and DMA take
+ * part as they would for any other user. A pass is started by writing to
+ * /sys/kernel/debug/ltq_crypto_bench/run and the throughput, p50/p99
+ * latency and cycles per byte tables are read from .../results.
+ *
+ * Works the same on the DEU and on the software register model.
+ *
+ * Copyright (C) 2021 Richard van Schagen <vschagen@icloud.com>
+ */
+
+#include <crypto/aead.h>
+#include <crypto/authenc.h>
+#include <crypto/hash.h>
+#include <crypto/sha.h>
+#include <crypto/skcipher.h>
+#include <linux/debugfs.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/rtnetlink.h>
+#include <linux/scatterlist.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/timex.h>
+
+#include "deu-core.h"
+
+static unsigned int iterations = 64;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Timed requests per algorithm, key, size and sg count (max 4096)");
+
+static unsigned int max_sg = 4;
+module_param(max_sg, uint, 0644);
+MODULE_PARM_DESC(max_sg, "Run with 1 up to this many scatterlist entries (max 8)");
+
+static char *alg;
+module_param(alg, charp, 0644);
+MODULE_PARM_DESC(alg, "Only run this driver name, e.g. cbc(aes-deu)");
+
+#define BENCH_MAX_ITER		4096
+#define BENCH_MAX_SG		8
+#define BENCH_MAX_LEN		16384
+#define BENCH_AAD		16
+#define BENCH_TAIL		64	/* AEAD tag, hash digest */
+#define BENCH_BUF_LEN		(BENCH_AAD + BENCH_MAX_LEN + BENCH_TAIL)
+#define BENCH_MAX_ROWS		1024
+
+static const unsigned int bench_sizes[] = {
+	16, 64, 256, 1024, 8192, 16384
+};
+
+#define BENCH_NSIZES		ARRAY_SIZE(bench_sizes)
+
+/* Cipher key lengths to try, setkey decides which ones apply */
+static const unsigned int bench_keylens[] = {
+	8, 16, 19, 20, 24, 27, 28, 32, 35, 36, 48, 64
+};
+
+struct bench_row {
+	char	name[64];
+	u64	kbps[BENCH_NSIZES];	/* 1/100 kB/s */
+	u64	p50[BENCH_NSIZES];	/* ns */
+	u64	p99[BENCH_NSIZES];	/* ns */
+	u64	cpb[BENCH_NSIZES];	/* 1/100 cycles per byte */
+};
+
+struct bench_req {
+	enum deu_alg_type	type;
+	bool			enc;
+	unsigned int		ivsize;
+	unsigned int		authsize;
+	union {
+		struct skcipher_request	*skcipher;
+		struct aead_request	*aead;
+		struct ahash_request	*ahash;
+	};
+	struct crypto_wait	wait;
+};
+
+/* Serialises runs and protects the results */
+static DEFINE_MUTEX(bench_lock);
+static struct bench_row *bench_rows;
+static unsigned int bench_nrows;
+static unsigned int bench_iters;
+
+/* Buffers of the run in progress, bench_lock held */
+static u8 *bench_a, *bench_b;
+static u64 *bench_ns;
+static struct scatterlist bench_sg_in[BENCH_MAX_SG];
+static struct scatterlist bench_sg_out[BENCH_MAX_SG];
+static u8 bench_iv0[32], bench_iv[32];
+static u8 bench_digest[BENCH_TAIL];
+
+static struct dentry *bench_debugfs;
+
+/* Split len bytes of buf over nsg entries, the last one takes the rest */
+static struct scatterlist *bench_sg(struct scatterlist *sg, u8 *buf,
+			unsigned int len, unsigned int nsg)
+{
+	unsigned int i, piece;
+
+	nsg = min(nsg, len);
+	piece = len / nsg;
+
+	sg_init_table(sg, nsg);
+	for (i = 0; i < nsg - 1; i++)
+		sg_set_buf(&sg[i], buf + i * piece, piece);
+	sg_set_buf(&sg[i], buf + i * piece, len - i * piece);
+
+	return sg;
+}
+
+/*
+ * Encrypt reads bench_a and writes bench_b, decrypt goes the other way,
+ * so an AEAD decrypt always sees the ciphertext and tag of the encrypt
+ * of the same size that ran just before it.
+ */
+static void bench_prepare(struct bench_req *br, unsigned int len,
+			unsigned int nsg)
+{
+	u8 *in = br->enc ? bench_a : bench_b;
+	u8 *out = br->enc ? bench_b : bench_a;
+	unsigned int ilen, olen;
+
+	switch (br->type) {
+	case DEU_ALG_TYPE_SKCIPHER:
+		skcipher_request_set_crypt(br->skcipher,
+				bench_sg(bench_sg_in, in, len, nsg),
+				bench_sg(bench_sg_out, out, len, nsg),
+				len, bench_iv);
+		break;
+	case DEU_ALG_TYPE_AEAD:
+		ilen = BENCH_AAD + len + (br->enc ? 0 : br->authsize);
+		olen = BENCH_AAD + len + (br->enc ? br->authsize : 0);
+		if (!br->enc)
+			memcpy(bench_b, bench_a, BENCH_AAD);
+		aead_request_set_ad(br->aead, BENCH_AAD);
+		aead_request_set_crypt(br->aead,
+				bench_sg(bench_sg_in, in, ilen, nsg),
+				bench_sg(bench_sg_out, out, olen, nsg),
+				ilen - BENCH_AAD, bench_iv);
+		break;
+	case DEU_ALG_TYPE_AHASH:
+	case DEU_ALG_TYPE_SHASH:
+		ahash_request_set_crypt(br->ahash,
+				bench_sg(bench_sg_in, bench_a, len, nsg),
+				bench_digest, len);
+		break;
+	}
+}
+
+static int bench_submit(struct bench_req *br)
+{
+	int err;
+
+	switch (br->type) {
+	case DEU_ALG_TYPE_SKCIPHER:
+		err = br->enc ? crypto_skcipher_encrypt(br->skcipher) :
+				crypto_skcipher_decrypt(br->skcipher);
+		break;
+	case DEU_ALG_TYPE_AEAD:
+		err = br->enc ? crypto_aead_encrypt(br->aead) :
+				crypto_aead_decrypt(br->aead);
+		break;
+	default:
+		err = crypto_ahash_digest(br->ahash);
+		break;
+	}
+
+	return crypto_wait_req(err, &br->wait);
+}
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* One warm-up request, then bench_iters timed ones into column col */
+static int bench_measure(struct bench_req *br, unsigned int len,
+			unsigned int nsg, struct bench_row *row,
+			unsigned int col)
+{
+	u64 total = 0, cycles = 0, bytes;
+	cycles_t c0;
+	u64 t0;
+	unsigned int i;
+	int err;
+
+	bench_prepare(br, len, nsg);
+
+	for (i = 0; i <= bench_iters; i++) {
+		memcpy(bench_iv, bench_iv0, br->ivsize);
+
+		t0 = ktime_get_ns();
+		c0 = get_cycles();
+		err = bench_submit(br);
+		c0 = get_cycles() - c0;
+		t0 = ktime_get_ns() - t0;
+		if (err)
+			return err;
+
+		if (i) {
+			bench_ns[i - 1] = t0;
+			total += t0;
+			cycles += c0;
+		}
+		cond_resched();
+	}
+
+	sort(bench_ns, bench_iters, sizeof(*bench_ns), bench_cmp_u64, NULL);
+
+	bytes = (u64)len * bench_iters;
+	row->kbps[col] = div64_u64(bytes * 100000000ULL, max_t(u64, total, 1));
+	row->p50[col] = bench_ns[bench_iters / 2];
+	row->p99[col] = bench_ns[min(bench_iters * 99 / 100, bench_iters - 1)];
+	row->cpb[col] = div64_u64(cycles * 100, bytes);
+
+	return 0;
+}
+
+static struct bench_row *bench_row_add(const char *name, unsigned int keybits,
+			const char *op, unsigned int nsg)
+{
+	struct bench_row *row;
+
+	if (bench_nrows >= BENCH_MAX_ROWS)
+		return NULL;
+
+	row = &bench_rows[bench_nrows++];
+	memset(row, 0, sizeof(*row));
+	if (keybits)
+		snprintf(row->name, sizeof(row->name), "%s %u %s sg%u",
+			 name, keybits, op, nsg);
+	else
+		snprintf(row->name, sizeof(row->name), "%s %s sg%u",
+			 name, op, nsg);
+
+	return row;
+}
+
+/* All sizes and sg counts for the key currently set */
+static void bench_key(struct bench_req *br, const char *name,
+			unsigned int keybits)
+{
+	bool hash = br->type == DEU_ALG_TYPE_AHASH ||
+		    br->type == DEU_ALG_TYPE_SHASH;
+	struct bench_row *enc, *dec = NULL;
+	unsigned int nsg, col;
+	int err;
+
+	for (nsg = 1; nsg <= min_t(unsigned int, max_sg, BENCH_MAX_SG); nsg++) {
+		enc = bench_row_add(name, keybits, hash ? "dig" : "enc", nsg);
+		if (!hash)
+			dec = bench_row_add(name, keybits, "dec", nsg);
+		if (!enc || (!hash && !dec))
+			return;
+
+		for (col = 0; col < BENCH_NSIZES; col++) {
+			br->enc = true;
+			err = bench_measure(br, bench_sizes[col], nsg, enc, col);
+			if (!err && dec) {
+				br->enc = false;
+				err = bench_measure(br, bench_sizes[col], nsg,
+						dec, col);
+			}
+			if (err) {
+				pr_warn("%s: %u bytes sg%u failed: %d\n",
+					name, bench_sizes[col], nsg, err);
+				return;
+			}
+		}
+	}
+}
+
+static int bench_authenc_setkey(struct crypto_aead *tfm, unsigned int enckeylen)
+{
+	u8 key[RTA_SPACE(sizeof(struct crypto_authenc_key_param)) +
+	       SHA1_DIGEST_SIZE + 32];
+	struct crypto_authenc_key_param *param;
+	struct rtattr *rta = (void *)key;
+	unsigned int len = RTA_SPACE(sizeof(*param));
+
+	if (enckeylen > 32)
+		return -EINVAL;
+
+	rta->rta_type = CRYPTO_AUTHENC_KEYA_PARAM;
+	rta->rta_len = RTA_LENGTH(sizeof(*param));
+	param = RTA_DATA(rta);
+	param->enckeylen = cpu_to_be32(enckeylen);
+	get_random_bytes(key + len, SHA1_DIGEST_SIZE + enckeylen);
+
+	return crypto_aead_setkey(tfm, key, len + SHA1_DIGEST_SIZE + enckeylen);
+}
+
+/*
+ * Set a random key of keylen bytes. Returns the key size in bits for the
+ * table (without nonce or authentication key), 0 for an unkeyed hash or
+ * a negative error if the algorithm does not take this length. *last is
+ * set when further key lengths would not change anything.
+ */
+static int bench_setkey(struct bench_req *br, const char *name,
+			unsigned int keylen, bool *last)
+{
+	u8 key[64];
+	int err;
+
+	get_random_bytes(key, keylen);
+
+	switch (br->type) {
+	case DEU_ALG_TYPE_SKCIPHER:
+		err = crypto_skcipher_setkey(
+			crypto_skcipher_reqtfm(br->skcipher), key, keylen);
+		break;
+	case DEU_ALG_TYPE_AEAD:
+		if (!strncmp(name, "authenc(", 8))
+			err = bench_authenc_setkey(
+				crypto_aead_reqtfm(br->aead), keylen);
+		else
+			err = crypto_aead_setkey(
+				crypto_aead_reqtfm(br->aead), key, keylen);
+		break;
+	default:
+		err = crypto_ahash_setkey(crypto_ahash_reqtfm(br->ahash),
+				key, keylen);
+		if (err == -ENOSYS) {
+			*last = true;
+			return 0;
+		}
+		/* The HMAC key only costs at setkey */
+		if (!err && !strncmp(name, "hmac(", 5))
+			*last = true;
+		break;
+	}
+	if (err)
+		return err;
+
+	if (!strncmp(name, "rfc4309(", 8))
+		keylen -= 3;
+	else if (!strncmp(name, "rfc", 3))
+		keylen -= 4;
+
+	return keylen * 8;
+}
+
+static void bench_alg(struct deu_alg_template *tmpl)
+{
+	const char *name = deu_alg_name(tmpl);
+	struct bench_req br = { .type = tmpl->type };
+	struct crypto_skcipher *skcipher = NULL;
+	struct crypto_aead *aead = NULL;
+	struct crypto_ahash *ahash = NULL;
+	unsigned int flags = CRYPTO_TFM_REQ_MAY_BACKLOG |
+			     CRYPTO_TFM_REQ_MAY_SLEEP;
+	unsigned int i;
+	bool last = false;
+	int keybits;
+
+	if (alg && *alg && strcmp(alg, name))
+		return;
+
+	crypto_init_wait(&br.wait);
+
+	switch (tmpl->type) {
+	case DEU_ALG_TYPE_SKCIPHER:
+		skcipher = crypto_alloc_skcipher(name, 0, 0);
+		if (IS_ERR(skcipher))
+			goto fail;
+		br.ivsize = crypto_skcipher_ivsize(skcipher);
+		br.skcipher = skcipher_request_alloc(skcipher, GFP_KERNEL);
+		if (!br.skcipher)
+			goto free;
+		skcipher_request_set_callback(br.skcipher, flags,
+				crypto_req_done, &br.wait);
+		break;
+	case DEU_ALG_TYPE_AEAD:
+		aead = crypto_alloc_aead(name, 0, 0);
+		if (IS_ERR(aead))
+			goto fail;
+		br.ivsize = crypto_aead_ivsize(aead);
+		br.authsize = crypto_aead_maxauthsize(aead);
+		br.aead = aead_request_alloc(aead, GFP_KERNEL);
+		if (!br.aead)
+			goto free;
+		aead_request_set_callback(br.aead, flags,
+				crypto_req_done, &br.wait);
+		break;
+	case DEU_ALG_TYPE_AHASH:
+	case DEU_ALG_TYPE_SHASH:
+		ahash = crypto_alloc_ahash(name, 0, 0);
+		if (IS_ERR(ahash))
+			goto fail;
+		br.ahash = ahash_request_alloc(ahash, GFP_KERNEL);
+		if (!br.ahash)
+			goto free;
+		ahash_request_set_callback(br.ahash, flags,
+				crypto_req_done, &br.wait);
+		break;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bench_keylens) && !last; i++) {
+		keybits = bench_setkey(&br, name, bench_keylens[i], &last);
+		if (keybits >= 0)
+			bench_key(&br, name, keybits);
+	}
+
+	switch (tmpl->type) {
+	case DEU_ALG_TYPE_SKCIPHER:
+		skcipher_request_free(br.skcipher);
+		break;
+	case DEU_ALG_TYPE_AEAD:
+		aead_request_free(br.aead);
+		break;
+	default:
+		ahash_request_free(br.ahash);
+		break;
+	}
+
+free:
+	if (skcipher)
+		crypto_free_skcipher(skcipher);
+	if (aead)
+		crypto_free_aead(aead);
+	if (ahash)
+		crypto_free_ahash(ahash);
+	return;
+
+fail:
+	pr_warn("%s: cannot allocate transform\n", name);
+}
+
+static int bench_run(void)
+{
+	struct deu_alg_template *tmpl;
+	unsigned int pos = 0;
+	int err = 0;
+
+	mutex_lock(&bench_lock);
+
+	bench_iters = clamp(iterations, 1U, (unsigned int)BENCH_MAX_ITER);
+	bench_nrows = 0;
+
+	bench_a = kmalloc(BENCH_BUF_LEN, GFP_KERNEL);
+	bench_b = kmalloc(BENCH_BUF_LEN, GFP_KERNEL);
+	bench_ns = kvmalloc_array(bench_iters, sizeof(*bench_ns), GFP_KERNEL);
+	if (!bench_a || !bench_b || !bench_ns) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	get_random_bytes(bench_a, BENCH_BUF_LEN);
+	get_random_bytes(bench_iv0, sizeof(bench_iv0));
+	/* CCM: 4 byte length field */
+	bench_iv0[0] = 3;
+
+	tmpl = deu_alg_iter(&pos);
+	if (!tmpl)
+		err = -ENODEV;
+
+	for (; tmpl; tmpl = deu_alg_iter(&pos))
+		bench_alg(tmpl);
+
+out:
+	kvfree(bench_ns);
+	kfree(bench_b);
+	kfree(bench_a);
+	bench_ns = NULL;
+	bench_a = bench_b = NULL;
+
+	mutex_unlock(&bench_lock);
+
+	return err;
+}
+
+static void bench_header(struct seq_file *s, const char *title, int width)
+{
+	unsigned int i;
+
+	seq_printf(s, "%s\n%-52s", title, "type");
+	for (i = 0; i < BENCH_NSIZES; i++)
+		seq_printf(s, "%*u bytes", width - 6, bench_sizes[i]);
+	seq_putc(s, '\n');
+}
+
+static int bench_results_show(struct seq_file *s, void *v)
+{
+	struct bench_row *row;
+	unsigned int i, j;
+
+	mutex_lock(&bench_lock);
+
+	if (!bench_nrows)
+		goto out;
+
+	seq_printf(s, "%u requests per entry\n\n", bench_iters);
+
+	bench_header(s, "The 'numbers' are in 1000s of bytes per second processed.", 13);
+	for (i = 0; i < bench_nrows; i++) {
+		row = &bench_rows[i];
+		seq_printf(s, "%-52s", row->name);
+		for (j = 0; j < BENCH_NSIZES; j++)
+			seq_printf(s, "%9llu.%02lluk", row->kbps[j] / 100,
+				   row->kbps[j] % 100);
+		seq_putc(s, '\n');
+	}
+
+	bench_header(s, "\nLatency p50/p99 in microseconds.", 18);
+	for (i = 0; i < bench_nrows; i++) {
+		row = &bench_rows[i];
+		seq_printf(s, "%-52s", row->name);
+		for (j = 0; j < BENCH_NSIZES; j++)
+			seq_printf(s, " %6llu.%llu/%6llu.%llu",
+				   row->p50[j] / 1000, row->p50[j] % 1000 / 100,
+				   row->p99[j] / 1000, row->p99[j] % 1000 / 100);
+		seq_putc(s, '\n');
+	}
+
+	bench_header(s, "\nCycles per byte.", 13);
+	for (i = 0; i < bench_nrows; i++) {
+		row = &bench_rows[i];
+		seq_printf(s, "%-52s", row->name);
+		for (j = 0; j < BENCH_NSIZES; j++)
+			seq_printf(s, "%10llu.%02llu", row->cpb[j] / 100,
+				   row->cpb[j] % 100);
+		seq_putc(s, '\n');
+	}
+
+out:
+	mutex_unlock(&bench_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(bench_results);
+
+static ssize_t bench_run_write(struct file *file, const char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	int err = bench_run();
+
+	return err ? err : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.owner	= THIS_MODULE,
+	.open	= simple_open,
+	.write	= bench_run_write,
+	.llseek	= noop_llseek,
+};
+
+static int __init deu_bench_init(void)
+{
+	bench_rows = kvcalloc(BENCH_MAX_ROWS, sizeof(*bench_rows), GFP_KERNEL);
+	if (!bench_rows)
+		return -ENOMEM;
+
+	bench_debugfs = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	debugfs_create_file("run", 0200, bench_debugfs, NULL, &bench_run_fops);
+	debugfs_create_file("results", 0444, bench_debugfs, NULL,
+				&bench_results_fops);
+
+	return 0;
+}
+
+static void __exit deu_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_debugfs);
+	kvfree(bench_rows);
+}
+
+module_init(deu_bench_init);
+module_exit(deu_bench_exit);
+
+MODULE_AUTHOR("Richard van Schagen <vschagen@icloud.com>");
+MODULE_DESCRIPTION("Infineon DEU crypto engine benchmark");
+MODULE_LICENSE("GPL v2");
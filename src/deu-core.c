@@ -5,18 +5,810 @@
  * Richard van Schagen <vschagen@icloud.com>
  */
 
+#include <crypto/skcipher.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/idr.h>
+#include <linux/interrupt.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
+#include <linux/random.h>
+#include <linux/rculist.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/timekeeping.h>
 
+#if IS_ENABLED(CONFIG_LANTIQ)
 #include <lantiq_soc.h>
+#else
+/* register model builds have no PMU to gate */
+static inline void ltq_pmu_enable(unsigned int module) {}
+static inline void ltq_pmu_disable(unsigned int module) {}
+#endif
 
 #include "deu-core.h"
 #include "deu-aes.h"
 #include "deu-des.h"
-//#include "deu-hash.h"
+#include "deu-dma.h"
+#include "deu-model.h"
+#include "deu-hash.h"
+
+#define CREATE_TRACE_POINTS
+#include "deu-trace.h"
+
+static const struct {
+	const char	*name;
+	bool		enabled;
+} deu_unit_info[DEU_UNIT_NUM] = {
+	[DEU_UNIT_DES] = {
+		.name = "des",
+		.enabled = IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_DES),
+	},
+	[DEU_UNIT_AES] = {
+		.name = "aes",
+		.enabled = IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_AES),
+	},
+	[DEU_UNIT_HASH] = {
+		.name = "hash",
+		.enabled = IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH),
+	},
+};
+
+/* Bound instances, changed under deu_devs_lock and walked under RCU */
+static LIST_HEAD(deu_devs);
+static DEFINE_MUTEX(deu_devs_lock);
+static DEFINE_IDA(deu_ida);
+
+static struct dentry *deu_debugfs_root;
+
+static unsigned int poll_spin = 64;
+module_param(poll_spin, uint, 0644);
+MODULE_PARM_DESC(poll_spin, "BUS polls before backing off with udelay");
+
+static unsigned int poll_hold = 5;
+module_param(poll_hold, uint, 0644);
+MODULE_PARM_DESC(poll_hold, "Microseconds to wait for BUS with the unit lock held (IRQs off)");
+
+static unsigned int poll_timeout = 1000;
+module_param(poll_timeout, uint, 0644);
+MODULE_PARM_DESC(poll_timeout, "Microseconds to wait for the engine");
+
+static unsigned int max_blocks = 64;
+module_param(max_blocks, uint, 0644);
+MODULE_PARM_DESC(max_blocks, "Blocks processed per unit lock hold (IRQs off)");
+
+static unsigned int sw_threshold = 64;
+module_param(sw_threshold, uint, 0444);
+MODULE_PARM_DESC(sw_threshold, "Initial size below which requests use the software fallback");
+
+static bool calibrate = true;
+module_param(calibrate, bool, 0444);
+MODULE_PARM_DESC(calibrate, "Measure the software fallback threshold at probe");
+
+static unsigned int offload_depth = 2;
+module_param(offload_depth, uint, 0644);
+MODULE_PARM_DESC(offload_depth, "Requests in flight on the DEU before new ones run in software (0 = never)");
+
+static unsigned int batch_max = 8;
+module_param(batch_max, uint, 0644);
+MODULE_PARM_DESC(batch_max, "Small requests run back to back in one unit session (max 16)");
+
+
+/*
+ * Key generations are unique over all tfms, so a context reallocated at
+ * the address of a freed one can never match the key left in a unit.
+ * Zero is never handed out and marks a context without a key.
+ */
+u32 deu_next_key_gen(void)
+{
+	static atomic_t key_gen = ATOMIC_INIT(0);
+	u32 gen;
+
+	do {
+		gen = atomic_inc_return(&key_gen);
+	} while (!gen);
+
+	return gen;
+}
+
+/*
+ * Pick the unit of type id with the fewest requests in flight on the
+ * instances taking requests, and count one more on it. Must be paired
+ * with deu_put_unit(). NULL when no bound instance has the unit.
+ */
+struct deu_unit *deu_get_unit(enum deu_unit_id id)
+{
+	struct deu_unit *unit, *best = NULL;
+	struct deu_dev *deu;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(deu, &deu_devs, list) {
+		unit = &deu->units[id];
+		if (!unit->engine || !READ_ONCE(deu->dispatch))
+			continue;
+		if (!best || atomic_read(&unit->inflight) <
+				atomic_read(&best->inflight))
+			best = unit;
+	}
+	if (best)
+		atomic_inc(&best->inflight);
+	rcu_read_unlock();
+
+	return best;
+}
+
+void deu_put_unit(struct deu_unit *unit)
+{
+	atomic_dec(&unit->inflight);
+}
+
+/*
+ * Decide whether a request goes to a unit's engine. Small requests are
+ * not worth the setup; when offload_depth requests are already in flight
+ * on the least loaded unit the submitting CPU runs the cipher in
+ * software instead of waiting for it, so SMP throughput becomes hardware
+ * plus software. A unit returned must be released with deu_put_unit().
+ */
+struct deu_unit *deu_claim_engine(enum deu_unit_id id,
+			struct deu_alg_template *tmpl, unsigned int nbytes,
+			int op)
+{
+	unsigned int depth = READ_ONCE(offload_depth);
+	struct deu_unit *unit;
+
+	unit = deu_get_unit(id);
+	if (!unit) {
+		atomic_long_inc(&tmpl->paths[DEU_PATH_SW_BUSY]);
+		return NULL;
+	}
+
+	deu_stat_request(unit, tmpl, nbytes, op);
+
+	if (nbytes < READ_ONCE(tmpl->sw_threshold)) {
+		deu_put_unit(unit);
+		atomic_long_inc(&tmpl->paths[DEU_PATH_SW_SMALL]);
+		return NULL;
+	}
+
+	if (atomic_read(&unit->inflight) > depth && depth) {
+		deu_put_unit(unit);
+		atomic_long_inc(&tmpl->paths[DEU_PATH_SW_BUSY]);
+		return NULL;
+	}
+
+	atomic_long_inc(&tmpl->paths[DEU_PATH_HW]);
+
+	return unit;
+}
+
+/*
+ * Called from do_one_request: park the request in the current batch.
+ * The engine runs with retry support, so -ENOSPC puts the request back
+ * at the head of the queue and the batch is run first. Requests are
+ * completed by run(), which gets the whole batch and can keep the unit
+ * lock, key and mode across them.
+ */
+int deu_batch_add(struct deu_unit *unit, struct crypto_async_request *req,
+			deu_batch_fn run)
+{
+	unsigned int max = clamp(READ_ONCE(batch_max), 1U, DEU_BATCH_MAX);
+
+	if (unit->batch_n &&
+	    (unit->batch_run != run || unit->batch_n >= max))
+		return -ENOSPC;
+
+	unit->batch_run = run;
+	unit->batch[unit->batch_n++] = req;
+
+	return 0;
+}
+
+/*
+ * Run the pending batch. Handlers that complete a request on their own
+ * call this first, so requests still finish in queue order.
+ */
+void deu_batch_flush(struct deu_unit *unit)
+{
+	unsigned int n = unit->batch_n;
+
+	if (!n)
+		return;
+
+	unit->batch_n = 0;
+	unit->batch_runs++;
+	unit->batch_reqs += n;
+
+	unit->batch_run(unit, unit->batch, n);
+}
+
+/* The engine's do_batch_requests, called once its queue has drained */
+static int deu_do_batch(struct crypto_engine *engine)
+{
+	deu_batch_flush(engine->priv_data);
+
+	return 0;
+}
+
+/* Sum the per-CPU counters of a unit or an algorithm */
+static int deu_stats_show(struct seq_file *s, void *v)
+{
+	struct deu_stats __percpu *pcpu = s->private;
+	struct deu_stats sum = { 0 };
+	const struct deu_stats *st;
+	unsigned int i;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(pcpu, cpu);
+		sum.requests += st->requests;
+		sum.bytes += st->bytes;
+		sum.walks += st->walks;
+		sum.key_loads += st->key_loads;
+		sum.wait_ns += st->wait_ns;
+		sum.hold_ns += st->hold_ns;
+		sum.polls += st->polls;
+		for (i = 0; i < DEU_SIZE_HIST; i++)
+			sum.size_hist[i] += st->size_hist[i];
+	}
+
+	seq_printf(s, "requests:  %llu\n", sum.requests);
+	seq_printf(s, "bytes:     %llu\n", sum.bytes);
+	seq_printf(s, "walks:     %llu\n", sum.walks);
+	seq_printf(s, "key loads: %llu\n", sum.key_loads);
+	seq_printf(s, "wait ns:   %llu\n", sum.wait_ns);
+	seq_printf(s, "hold ns:   %llu\n", sum.hold_ns);
+	seq_printf(s, "polls:     %llu\n", sum.polls);
+
+	seq_printf(s, "size 0      %llu\n", sum.size_hist[0]);
+	for (i = 1; i < DEU_SIZE_HIST - 1; i++)
+		seq_printf(s, "size < %-5u %llu\n", 1 << i, sum.size_hist[i]);
+	seq_printf(s, "size >= %-4u %llu\n", 1 << (i - 1), sum.size_hist[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(deu_stats);
+
+/* Queued to completed latency of an algorithm's engine requests */
+static int deu_latency_show(struct seq_file *s, void *v)
+{
+	struct deu_stats __percpu *pcpu = s->private;
+	u64 hist[DEU_LAT_HIST] = { 0 };
+	unsigned int i;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		for (i = 0; i < DEU_LAT_HIST; i++)
+			hist[i] += per_cpu_ptr(pcpu, cpu)->lat_hist[i];
+	}
+
+	for (i = 0; i < DEU_LAT_HIST - 1; i++)
+		seq_printf(s, "us <  %-6u %llu\n", 1 << i, hist[i]);
+	seq_printf(s, "us >= %-6u %llu\n", 1 << (i - 1), hist[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(deu_latency);
+
+static int deu_unit_stats_show(struct seq_file *s, void *v)
+{
+	struct deu_unit_stats *stats = s->private;
+	unsigned int i;
+
+	seq_printf(s, "blocks:    %llu\n", stats->blocks);
+	seq_printf(s, "polls:     %llu\n", stats->polls);
+	seq_printf(s, "max polls: %u\n", stats->max_polls);
+	seq_printf(s, "slow:      %llu\n", stats->slow);
+	seq_printf(s, "timeouts:  %llu\n", stats->timeouts);
+	seq_printf(s, "holds:     %llu\n", stats->holds);
+	seq_printf(s, "hold ns:   %llu\n", stats->hold_ns);
+	seq_printf(s, "max hold:  %llu ns\n", stats->hold_max_ns);
+	seq_printf(s, "parks:     %llu\n", stats->parks);
+
+	for (i = 0; i < DEU_POLL_HIST - 1; i++)
+		seq_printf(s, "polls <  %-4u %llu\n", 1 << i, stats->hist[i]);
+	seq_printf(s, "polls >= %-4u %llu\n", 1 << (i - 1), stats->hist[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(deu_unit_stats);
+
+/* Fixed part of the units, before ltq_deu_start() touches them */
+static void deu_units_setup(struct deu_dev *deu)
+{
+	struct deu_unit *unit;
+	unsigned int i;
+
+	for (i = 0; i < DEU_UNIT_NUM; i++) {
+		unit = &deu->units[i];
+		unit->name = deu_unit_info[i].name;
+		unit->id = i;
+		unit->enabled = deu_unit_info[i].enabled;
+		unit->deu = deu;
+		spin_lock_init(&unit->lock);
+		init_completion(&unit->done);
+	}
+}
+
+static void deu_units_exit(struct deu_dev *deu)
+{
+	struct deu_unit *unit;
+	unsigned int i;
+
+	for (i = 0; i < DEU_UNIT_NUM; i++) {
+		unit = &deu->units[i];
+		if (unit->engine)
+			crypto_engine_exit(unit->engine);
+		unit->engine = NULL;
+		free_percpu(unit->stats);
+		unit->stats = NULL;
+	}
+}
+
+/*
+ * One engine per unit. The clock and the shared control setup are done
+ * by ltq_deu_start() before any worker exists and undone only after all
+ * of them are gone; at run time each worker only touches its own unit,
+ * and the DMA controller, the one resource the units share, is
+ * serialised in deu_dma_transfer().
+ */
+static int deu_units_init(struct deu_dev *deu)
+{
+	struct device *dev = deu->dev;
+	struct deu_unit *unit;
+	struct dentry *dir;
+	char name[16];
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < DEU_UNIT_NUM; i++) {
+		unit = &deu->units[i];
+		if (!unit->enabled)
+			continue;
+
+		atomic_set(&unit->inflight, 0);
+		unit->batch_n = 0;
+
+		unit->stats = alloc_percpu(struct deu_stats);
+		if (!unit->stats) {
+			err = -ENOMEM;
+			goto fail;
+		}
+
+		unit->engine = crypto_engine_alloc_init_and_set(dev, true,
+						deu_do_batch, true,
+						DEU_QUEUE_LEN);
+		if (!unit->engine) {
+			dev_err(dev, "failed to allocate %s engine\n",
+				unit->name);
+			err = -ENOMEM;
+			goto fail;
+		}
+		unit->engine->priv_data = unit;
+
+		err = crypto_engine_start(unit->engine);
+		if (err) {
+			dev_err(dev, "failed to start %s engine\n",
+				unit->name);
+			goto fail;
+		}
+
+		dir = debugfs_create_dir(unit->name, deu->debugfs);
+		debugfs_create_atomic_t("inflight", 0444, dir,
+					&unit->inflight);
+		debugfs_create_ulong("batch_runs", 0444, dir,
+					&unit->batch_runs);
+		debugfs_create_ulong("batch_reqs", 0444, dir,
+					&unit->batch_reqs);
+		debugfs_create_file("stats", 0444, dir, unit->stats,
+					&deu_stats_fops);
+
+		snprintf(name, sizeof(name), "%s_stats", unit->name);
+		debugfs_create_file(name, 0444, deu->debugfs, &unit->lstats,
+					&deu_unit_stats_fops);
+	}
+
+	return 0;
+
+fail:
+	deu_units_exit(deu);
+
+	return err;
+}
+
+/* Wait for the requests already handed to a removed instance */
+static void deu_units_drain(struct deu_dev *deu)
+{
+	unsigned int i;
 
-static void __iomem *ltq_clk_membase;
+	for (i = 0; i < DEU_UNIT_NUM; i++) {
+		while (atomic_read(&deu->units[i].inflight))
+			msleep(1);
+	}
+}
+
+/*
+ * Long transfers are split so the unit lock, and with it IRQs, is never
+ * held for more than max_blocks blocks. The IV is read back at the end
+ * of each chunk and reloaded at the start of the next one.
+ */
+unsigned int deu_chunk_blocks(void)
+{
+	return max(READ_ONCE(max_blocks), 1U);
+}
+
+/* Count a request of nbytes on entry, whichever path it takes after */
+void deu_stat_request(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			unsigned int nbytes, int op)
+{
+	unsigned int bucket = min_t(unsigned int, fls(nbytes),
+				DEU_SIZE_HIST - 1);
+
+	deu_stat_add(unit, tmpl, requests, 1);
+	deu_stat_add(unit, tmpl, bytes, nbytes);
+	deu_stat_add(unit, tmpl, size_hist[bucket], 1);
+
+	trace_deu_request(tmpl, nbytes, op);
+}
+
+void deu_stat_walk(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			unsigned int nbytes, int op)
+{
+	deu_stat_add(unit, tmpl, walks, 1);
+
+	trace_deu_walk(tmpl, nbytes, op);
+}
+
+void deu_stat_key_load(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			unsigned int keylen)
+{
+	deu_stat_add(unit, tmpl, key_loads, 1);
+
+	trace_deu_key_load(tmpl, keylen);
+}
+
+/*
+ * An engine request is about to be finalized. queued is the
+ * ktime_get_ns() at which it was handed to the engine; the worker
+ * usually runs on another CPU, so local_clock() would not do.
+ */
+void deu_stat_done(struct deu_alg_template *tmpl, u64 queued,
+			unsigned int nbytes, int op, int err)
+{
+	u64 ns = ktime_get_ns() - queued;
+	unsigned int bucket = min_t(unsigned int,
+				fls64(div_u64(ns, NSEC_PER_USEC)),
+				DEU_LAT_HIST - 1);
+
+	this_cpu_inc(tmpl->stats->lat_hist[bucket]);
+
+	trace_deu_complete(tmpl, nbytes, op, err, ns);
+}
+
+/* Call right after taking the unit lock asked for at wait, returns start */
+u64 deu_lock_taken(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			u64 wait)
+{
+	u64 start = local_clock();
+
+	trace_deu_lock(unit, tmpl, start - wait);
+
+	return start;
+}
+
+/*
+ * Account an IRQ-off section: the lock was asked for at @wait and taken
+ * at @start. Caller still holds the lock. tmpl may be NULL when the
+ * section does not belong to one algorithm.
+ */
+void deu_account_hold(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			u64 wait, u64 start)
+{
+	struct deu_unit_stats *stats = &unit->lstats;
+	u64 held = local_clock() - start - stats->sec_park_ns;
+
+	stats->sec_park_ns = 0;
+	stats->holds++;
+	stats->hold_ns += held;
+	if (held > stats->hold_max_ns)
+		stats->hold_max_ns = held;
+
+	deu_stat_add(unit, tmpl, wait_ns, start - wait);
+	deu_stat_add(unit, tmpl, hold_ns, held);
+	deu_stat_add(unit, tmpl, polls, stats->sec_polls);
+	stats->sec_polls = 0;
+}
+
+/* One wait of a parked section, the IRQ wait ends early */
+#define DEU_PARK_MIN_US		10
+#define DEU_PARK_MAX_US		50
+
+/* BUS of a unit, the model finishes its block here when it is due */
+static bool deu_unit_busy(struct deu_unit *unit)
+{
+	union deu_status status;
+
+	if (unit->deu->model)
+		deu_model_poll(unit);
+	status.word = __raw_readl(unit->base);
+
+	return status.bits.BUS;
+}
+
+/*
+ * The unit is driven without the lock: wait with it released and IRQs
+ * on. Owners that do not sleep keep preemption off meanwhile, so a
+ * caller that cannot sleep only ever spins on another CPU's owner.
+ */
+static void deu_unit_wait_owner(struct deu_unit *unit, unsigned long *flags,
+			bool may_sleep)
+{
+	while (unit->owned) {
+		spin_unlock_irqrestore(&unit->lock, *flags);
+		if (may_sleep)
+			usleep_range(DEU_PARK_MIN_US, DEU_PARK_MAX_US);
+		else
+			udelay(1);
+		spin_lock_irqsave(&unit->lock, *flags);
+	}
+}
+
+/*
+ * Lock a unit for a section that drives it. Waits out an owner driving
+ * the unit without the lock, and lets deu_wait_ready() park the section
+ * while a block is slow. may_sleep says the section can sleep in there;
+ * sections inside a skcipher walk step cannot, 5.10 maps those pages
+ * with kmap_atomic. Release with deu_unit_unlock().
+ */
+void deu_unit_lock(struct deu_unit *unit, unsigned long *flags,
+			bool may_sleep)
+{
+	spin_lock_irqsave(&unit->lock, *flags);
+	deu_unit_wait_owner(unit, flags, may_sleep);
+
+	unit->irqflags = flags;
+	unit->may_sleep = may_sleep;
+}
+
+/* For callers that cannot wait: false, unlocked, while the unit is owned */
+bool deu_unit_trylock(struct deu_unit *unit, unsigned long *flags)
+{
+	spin_lock_irqsave(&unit->lock, *flags);
+	if (unit->owned) {
+		spin_unlock_irqrestore(&unit->lock, *flags);
+		return false;
+	}
+
+	unit->irqflags = flags;
+	unit->may_sleep = false;
+
+	return true;
+}
+
+void deu_unit_unlock(struct deu_unit *unit, unsigned long *flags)
+{
+	unit->irqflags = NULL;
+	spin_unlock_irqrestore(&unit->lock, *flags);
+}
+
+/*
+ * Own a unit across sections that cannot wait for it: authenc claims
+ * the hash unit before its walk. Process context only.
+ */
+void deu_unit_claim(struct deu_unit *unit)
+{
+	unsigned long flags;
+
+	deu_unit_lock(unit, &flags, true);
+	unit->owned = true;
+	deu_unit_unlock(unit, &flags);
+}
+
+void deu_unit_release(struct deu_unit *unit)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&unit->lock, flags);
+	unit->owned = false;
+	spin_unlock_irqrestore(&unit->lock, flags);
+}
+
+/*
+ * An authenc section: the cipher unit, then the hash unit the caller
+ * claimed. A slow block parks the pair, both locks are dropped and
+ * both units stay owned. Release with deu_unit_unlock_pair().
+ */
+void deu_unit_lock_pair(struct deu_unit *unit, struct deu_unit *hu,
+			unsigned long *flags)
+{
+	spin_lock_irqsave(&unit->lock, *flags);
+	deu_unit_wait_owner(unit, flags, false);
+	spin_lock(&hu->lock);
+
+	unit->irqflags = flags;
+	unit->may_sleep = false;
+	unit->pair = hu;
+	hu->irqflags = flags;
+	hu->may_sleep = false;
+	hu->pair = unit;
+}
+
+void deu_unit_unlock_pair(struct deu_unit *unit, struct deu_unit *hu,
+			unsigned long *flags)
+{
+	hu->pair = NULL;
+	hu->irqflags = NULL;
+	unit->pair = NULL;
+	unit->irqflags = NULL;
+	spin_unlock(&hu->lock);
+	spin_unlock_irqrestore(&unit->lock, *flags);
+}
+
+/*
+ * Release the lock of a section until the block in flight finishes, so
+ * IRQs are back on. The unit stays owned, nobody touches its registers
+ * meanwhile. A section that may sleep waits for the DEU interrupt, with
+ * a short timeout in case it is not raised, or in usleep_range(); any
+ * other polls with preemption off.
+ */
+static void deu_unit_park(struct deu_unit *unit)
+{
+	struct deu_unit *pair = unit->pair;
+	struct deu_unit *first = unit, *second = pair;
+	unsigned long *flags = unit->irqflags;
+	bool may_sleep = unit->may_sleep;
+	bool irq = may_sleep && unit->deu->irq > 0;
+	bool pair_owned = false;
+	u64 start = local_clock();
+	unsigned int i;
+	u64 ns;
+
+	/* a pair was locked cipher unit first, which has the lower id */
+	if (pair && pair->id < unit->id) {
+		first = pair;
+		second = unit;
+	}
+
+	unit->owned = true;
+	unit->irqflags = NULL;
+	if (pair) {
+		/* the hash unit of a pair is already claimed */
+		pair_owned = pair->owned;
+		pair->owned = true;
+		pair->irqflags = NULL;
+	}
+	if (irq) {
+		reinit_completion(&unit->done);
+		WRITE_ONCE(unit->irq_wait, true);
+	}
+	if (!may_sleep)
+		preempt_disable();
+	if (pair)
+		spin_unlock(&second->lock);
+	spin_unlock_irqrestore(&first->lock, *flags);
+
+	/* the interrupt may have come before irq_wait was set */
+	if (deu_unit_busy(unit)) {
+		if (irq)
+			wait_for_completion_timeout(&unit->done,
+					usecs_to_jiffies(DEU_PARK_MAX_US) + 1);
+		else if (may_sleep)
+			usleep_range(DEU_PARK_MIN_US, DEU_PARK_MAX_US);
+		else
+			for (i = 0; i < DEU_PARK_MAX_US; i++) {
+				if (!deu_unit_busy(unit))
+					break;
+				udelay(1);
+			}
+	}
+
+	spin_lock_irqsave(&first->lock, *flags);
+	if (pair)
+		spin_lock(&second->lock);
+	if (!may_sleep)
+		preempt_enable();
+	WRITE_ONCE(unit->irq_wait, false);
+	unit->irqflags = flags;
+	unit->may_sleep = may_sleep;
+	unit->owned = false;
+
+	ns = local_clock() - start;
+	unit->lstats.parks++;
+	unit->lstats.sec_park_ns += ns;
+	if (pair) {
+		pair->irqflags = flags;
+		pair->owned = pair_owned;
+		pair->lstats.sec_park_ns += ns;
+	}
+}
+
+/*
+ * Wait for the BUS bit to clear. A block normally completes within a
+ * few reads, so spin first and then back off in 1us steps, but for no
+ * more than poll_hold us with the lock held and IRQs off. After that a
+ * section parks until BUS clears; only a block still busy after
+ * poll_timeout, a hardware fault, fails with -ETIMEDOUT.
+ * Caller holds the unit lock, which also protects the stats.
+ */
+int deu_wait_ready(struct deu_unit *unit)
+{
+	struct deu_unit_stats *stats = &unit->lstats;
+	unsigned int polls = 0;
+	unsigned int waited = 0;
+	u64 deadline = 0;
+
+	if (unit->deu->model)
+		deu_model_run(unit);
+
+	for (;;) {
+		if (!deu_unit_busy(unit))
+			break;
+
+		if (++polls < poll_spin) {
+			cpu_relax();
+			continue;
+		}
+
+		if (waited++ < READ_ONCE(poll_hold)) {
+			udelay(1);
+			continue;
+		}
+
+		if (!deadline)
+			deadline = ktime_get_ns() +
+				(u64)READ_ONCE(poll_timeout) * NSEC_PER_USEC;
+
+		if (!unit->irqflags || ktime_get_ns() > deadline) {
+			stats->timeouts++;
+			return -ETIMEDOUT;
+		}
+		deu_unit_park(unit);
+	}
+
+	stats->blocks++;
+	stats->polls += polls;
+	stats->sec_polls += polls;
+	if (waited)
+		stats->slow++;
+	if (polls > stats->max_polls)
+		stats->max_polls = polls;
+	stats->hist[min_t(unsigned int, fls(polls), DEU_POLL_HIST - 1)]++;
+
+	return 0;
+}
+
+/*
+ * The interrupt is only ours when a parked waiter asked for it and its
+ * unit has cleared BUS. Anything else, spurious or from another device
+ * on the line, is left alone.
+ */
+static irqreturn_t ltq_deu_irq_handler(int irq, void *dev_id)
+{
+	struct deu_dev *deu = dev_id;
+	irqreturn_t ret = IRQ_NONE;
+	union deu_status status;
+	struct deu_unit *unit;
+	unsigned int i;
+
+	for (i = 0; i < DEU_UNIT_NUM; i++) {
+		unit = &deu->units[i];
+		if (!READ_ONCE(unit->irq_wait))
+			continue;
+
+		status.word = __raw_readl(unit->base);
+		if (status.bits.BUS)
+			continue;
+
+		WRITE_ONCE(unit->irq_wait, false);
+		complete(&unit->done);
+		ret = IRQ_HANDLED;
+	}
+
+	return ret;
+}
 
 extern struct deu_alg_template deu_alg_ecb_aes;
 extern struct deu_alg_template deu_alg_cbc_aes;
@@ -25,6 +817,14 @@ extern struct deu_alg_template deu_alg_cfb_aes;
 extern struct deu_alg_template deu_alg_ctr_aes;
 extern struct deu_alg_template deu_alg_rfc3686_aes;
 extern struct deu_alg_template deu_alg_xts_aes;
+extern struct deu_alg_template deu_alg_gcm_aes;
+extern struct deu_alg_template deu_alg_rfc4106_aes;
+extern struct deu_alg_template deu_alg_ccm_aes;
+extern struct deu_alg_template deu_alg_rfc4309_aes;
+extern struct deu_alg_template deu_alg_cbcmac_aes;
+extern struct deu_alg_template deu_alg_cmac_aes;
+extern struct deu_alg_template deu_alg_xcbc_aes;
+extern struct deu_alg_template deu_alg_authenc_sha1_cbc_aes;
 
 extern struct deu_alg_template deu_alg_ecb_des;
 extern struct deu_alg_template deu_alg_cbc_des;
@@ -37,8 +837,12 @@ extern struct deu_alg_template deu_alg_cbc_des3_ede;
 extern struct deu_alg_template deu_alg_ofb_des3_ede;
 extern struct deu_alg_template deu_alg_cfb_des3_ede;
 extern struct deu_alg_template deu_alg_ctr_des3_ede;
+extern struct deu_alg_template deu_alg_authenc_sha1_cbc_des3_ede;
 
-//extern struct deu_alg_template deu_alg_sha1;
+extern struct deu_alg_template deu_alg_sha1;
+extern struct deu_alg_template deu_alg_md5;
+extern struct deu_alg_template deu_alg_hmac_sha1;
+extern struct deu_alg_template deu_alg_hmac_md5;
 
 static struct deu_alg_template *deu_algs[] = {
 #if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_DES)
@@ -52,6 +856,9 @@ static struct deu_alg_template *deu_algs[] = {
 	&deu_alg_ofb_des3_ede,
 	&deu_alg_cfb_des3_ede,
 	&deu_alg_ctr_des3_ede,
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+	&deu_alg_authenc_sha1_cbc_des3_ede,
+#endif
 #endif
 #if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_AES)
 	&deu_alg_ecb_aes,
@@ -61,21 +868,73 @@ static struct deu_alg_template *deu_algs[] = {
 	&deu_alg_ctr_aes,
 	&deu_alg_rfc3686_aes,
 	&deu_alg_xts_aes,
+	&deu_alg_gcm_aes,
+	&deu_alg_rfc4106_aes,
+	&deu_alg_ccm_aes,
+	&deu_alg_rfc4309_aes,
+	&deu_alg_cbcmac_aes,
+	&deu_alg_cmac_aes,
+	&deu_alg_xcbc_aes,
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+	&deu_alg_authenc_sha1_cbc_aes,
+#endif
 #endif
 #if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
-//	&deu_alg_sha1,
-//	&deu_alg_md5,
-//	&deu_alg_hmac_md5,
-//	&deu_alg_sha1,
-//	&deu_alg_hmac_sha1,
+	&deu_alg_sha1,
+	&deu_alg_md5,
+	&deu_alg_hmac_sha1,
+	&deu_alg_hmac_md5,
 #endif
 };
 
+/* Set while deu_algs[] is registered with the crypto API */
+static bool deu_algs_registered;
+
+static struct dentry *deu_alg_dirs[ARRAY_SIZE(deu_algs)];
+
+/*
+ * Walk the registered algorithms, for ltq-crypto-bench. Start with
+ * *pos = 0; returns NULL at the end or while the driver is not bound.
+ */
+struct deu_alg_template *deu_alg_iter(unsigned int *pos)
+{
+	if (!READ_ONCE(deu_algs_registered) || *pos >= ARRAY_SIZE(deu_algs))
+		return NULL;
+
+	return deu_algs[(*pos)++];
+}
+EXPORT_SYMBOL_GPL(deu_alg_iter);
+
+/* Driver name, "-" for a section shared by several algorithms */
+const char *deu_alg_name(struct deu_alg_template *tmpl)
+{
+	if (!tmpl)
+		return "-";
+
+	switch (tmpl->type) {
+	case DEU_ALG_TYPE_SKCIPHER:
+		return tmpl->alg.skcipher.base.cra_driver_name;
+	case DEU_ALG_TYPE_AEAD:
+		return tmpl->alg.aead.base.cra_driver_name;
+	case DEU_ALG_TYPE_AHASH:
+		return tmpl->alg.ahash.halg.base.cra_driver_name;
+	case DEU_ALG_TYPE_SHASH:
+		return tmpl->alg.shash.base.cra_driver_name;
+	}
+
+	return "-";
+}
+EXPORT_SYMBOL_GPL(deu_alg_name);
+
 static void deu_unregister_algs(unsigned int i)
 {
 	unsigned int j;
 
 	for (j = 0; j < i; j++) {
+		/* the stats files point at the counters freed below */
+		debugfs_remove_recursive(deu_alg_dirs[j]);
+		deu_alg_dirs[j] = NULL;
+
 		switch (deu_algs[j]->type) {
 		case DEU_ALG_TYPE_SKCIPHER:
 			crypto_unregister_skcipher(&deu_algs[j]->alg.skcipher);
@@ -85,7 +944,12 @@ static void deu_unregister_algs(unsigned int i)
 			break;
 		case DEU_ALG_TYPE_SHASH:
 			crypto_unregister_shash(&deu_algs[j]->alg.shash);
+			break;
+		case DEU_ALG_TYPE_AEAD:
+			crypto_unregister_aead(&deu_algs[j]->alg.aead);
 		}
+		free_percpu(deu_algs[j]->stats);
+		deu_algs[j]->stats = NULL;
 	}
 }
 
@@ -95,8 +959,15 @@ static int deu_register_algs(void)
 	unsigned int i;
 
 	for (i = 0; i < ARRAY_SIZE(deu_algs); i++) {
+		deu_algs[i]->stats = alloc_percpu(struct deu_stats);
+		if (!deu_algs[i]->stats) {
+			err = -ENOMEM;
+			goto fail;
+		}
+
 		switch (deu_algs[i]->type) {
 		case DEU_ALG_TYPE_SKCIPHER:
+			deu_algs[i]->sw_threshold = sw_threshold;
 			err = crypto_register_skcipher(&deu_algs[i]->alg.skcipher);
 			break;
 		case DEU_ALG_TYPE_AHASH:
@@ -105,9 +976,16 @@ static int deu_register_algs(void)
 		case DEU_ALG_TYPE_SHASH:
 			err = crypto_register_shash(&deu_algs[i]->alg.shash);
 			break;
+		case DEU_ALG_TYPE_AEAD:
+			deu_algs[i]->sw_threshold = sw_threshold;
+			err = crypto_register_aead(&deu_algs[i]->alg.aead);
+			break;
 		}
-		if (err)
+		if (err) {
+			free_percpu(deu_algs[i]->stats);
+			deu_algs[i]->stats = NULL;
 			goto fail;
+		}
 	}
 
 	return 0;
@@ -118,12 +996,160 @@ fail:
 	return err;
 }
 
-static void ltq_deu_start(__iomem void *base)
+#define DEU_CAL_MIN		16
+#define DEU_CAL_MAX		1024
+#define DEU_CAL_RUNS		8
+
+/* Best of DEU_CAL_RUNS encryptions of len bytes, in ns */
+static u64 deu_calibrate_run(struct crypto_skcipher *tfm,
+			struct scatterlist *sg, u8 *iv, unsigned int len)
+{
+	struct skcipher_request *req;
+	DECLARE_CRYPTO_WAIT(wait);
+	u64 best = U64_MAX;
+	u64 start;
+	int i, err;
+
+	req = skcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!req)
+		return U64_MAX;
+
+	skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				crypto_req_done, &wait);
+
+	for (i = 0; i < DEU_CAL_RUNS; i++) {
+		skcipher_request_set_crypt(req, sg, sg, len, iv);
+		start = local_clock();
+		err = crypto_wait_req(crypto_skcipher_encrypt(req), &wait);
+		if (err) {
+			best = U64_MAX;
+			break;
+		}
+		best = min(best, local_clock() - start);
+	}
+
+	skcipher_request_free(req);
+
+	return best;
+}
+
+/*
+ * Find the smallest request size at which the DEU beats the software
+ * implementation. Below it the lock, key load and MMIO setup cost more
+ * than the cipher itself. Leaves the default on any failure.
+ */
+static void deu_calibrate_alg(struct device *dev,
+			struct deu_alg_template *tmpl)
 {
-	ltq_clk_membase = base;
+	struct skcipher_alg *alg = &tmpl->alg.skcipher;
+	struct crypto_skcipher *hw, *sw;
+	u8 key[2 * AES_MAX_KEY_SIZE];
+	u8 iv[AES_BLOCK_SIZE];
+	struct scatterlist sg;
+	unsigned int len, threshold = 2 * DEU_CAL_MAX;
+	u8 *buf;
+
+	hw = crypto_alloc_skcipher(alg->base.cra_driver_name, 0, 0);
+	if (IS_ERR(hw))
+		return;
+
+	sw = crypto_alloc_skcipher(alg->base.cra_name, 0, CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(sw))
+		goto free_hw;
+
+	buf = kzalloc(DEU_CAL_MAX, GFP_KERNEL);
+	if (!buf)
+		goto free_sw;
+
+	get_random_bytes(key, sizeof(key));
+	if (crypto_skcipher_setkey(hw, key, alg->min_keysize) ||
+			crypto_skcipher_setkey(sw, key, alg->min_keysize))
+		goto free_buf;
 
-	if (base) {
-		union clk_control *clk = (union clk_control *)ltq_clk_membase;
+	sg_init_one(&sg, buf, DEU_CAL_MAX);
+	memset(iv, 0, sizeof(iv));
+
+	WRITE_ONCE(tmpl->sw_threshold, 0);
+
+	for (len = DEU_CAL_MIN; len <= DEU_CAL_MAX; len *= 2) {
+		u64 t_hw = deu_calibrate_run(hw, &sg, iv, len);
+		u64 t_sw = deu_calibrate_run(sw, &sg, iv, len);
+
+		if (t_hw == U64_MAX || t_sw == U64_MAX) {
+			threshold = sw_threshold;
+			break;
+		}
+		if (t_hw <= t_sw) {
+			threshold = len;
+			break;
+		}
+	}
+
+	WRITE_ONCE(tmpl->sw_threshold, threshold);
+	dev_dbg(dev, "%s: software below %u bytes\n",
+		alg->base.cra_driver_name, threshold);
+
+free_buf:
+	kfree(buf);
+free_sw:
+	crypto_free_skcipher(sw);
+free_hw:
+	crypto_free_skcipher(hw);
+}
+
+static int deu_alg_paths_show(struct seq_file *s, void *v)
+{
+	struct deu_alg_template *tmpl = s->private;
+
+	seq_printf(s, "hw:        %ld\n",
+		atomic_long_read(&tmpl->paths[DEU_PATH_HW]));
+	seq_printf(s, "sw small:  %ld\n",
+		atomic_long_read(&tmpl->paths[DEU_PATH_SW_SMALL]));
+	seq_printf(s, "sw busy:   %ld\n",
+		atomic_long_read(&tmpl->paths[DEU_PATH_SW_BUSY]));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(deu_alg_paths);
+
+/* Calibrate the fallback thresholds, expose the per-algorithm knobs and stats */
+static void deu_tune_algs(struct device *dev)
+{
+	struct deu_alg_template *tmpl;
+	struct dentry *dir;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(deu_algs); i++) {
+		tmpl = deu_algs[i];
+
+		if (tmpl->type == DEU_ALG_TYPE_SKCIPHER && calibrate)
+			deu_calibrate_alg(dev, tmpl);
+
+		dir = debugfs_create_dir(deu_alg_name(tmpl),
+					deu_debugfs_root);
+		deu_alg_dirs[i] = dir;
+		debugfs_create_file("stats", 0444, dir, tmpl->stats,
+					&deu_stats_fops);
+		debugfs_create_file("latency", 0444, dir, tmpl->stats,
+					&deu_latency_fops);
+
+		/* hashes and MACs have no software threshold */
+		if (tmpl->type == DEU_ALG_TYPE_AHASH ||
+		    tmpl->type == DEU_ALG_TYPE_SHASH)
+			continue;
+
+		debugfs_create_u32("sw_threshold", 0644, dir,
+					&tmpl->sw_threshold);
+		debugfs_create_file("paths", 0444, dir, tmpl,
+					&deu_alg_paths_fops);
+	}
+}
+
+static void ltq_deu_start(struct deu_dev *deu)
+{
+	if (!deu->model) {
+		union clk_control *clk = (union clk_control *)deu->base;
 
 		ltq_pmu_enable(PMU_DEU);
 
@@ -135,19 +1161,22 @@ static void ltq_deu_start(__iomem void *base)
 		clk->bits.DISR = 0;
 	}
 #if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_AES)
-	aes_init_hw(base);
+	aes_init_hw(&deu->units[DEU_UNIT_AES], deu->base);
 #endif
 #if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_DES)
-	des_init_hw(base);
+	des_init_hw(&deu->units[DEU_UNIT_DES], deu->base);
 #endif
 #if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
-//	hash_init_hw(base);
+	hash_init_hw(&deu->units[DEU_UNIT_HASH], deu->base);
 #endif
 }
 
-static void ltq_deu_stop(void)
+static void ltq_deu_stop(struct deu_dev *deu)
 {
-	union clk_control *clk = (union clk_control *)ltq_clk_membase;
+	union clk_control *clk = (union clk_control *)deu->base;
+
+	if (deu->model)
+		return;
 
 	ltq_pmu_disable(PMU_DEU);
 
@@ -159,14 +1188,81 @@ static void ltq_deu_stop(void)
 	clk->bits.DISR = 1;
 }
 
+/*
+ * Make the instance visible to deu_get_unit(). The algorithms are
+ * registered with the first one and serve all instances bound later.
+ */
+static int deu_dev_add(struct deu_dev *deu)
+{
+	int err = 0;
+
+	mutex_lock(&deu_devs_lock);
+
+	list_add_tail_rcu(&deu->list, &deu_devs);
+
+	if (!list_is_singular(&deu_devs))
+		goto unlock;
+
+	err = deu_register_algs();
+	if (err) {
+		list_del_rcu(&deu->list);
+		goto unlock;
+	}
+
+	WRITE_ONCE(deu_algs_registered, true);
+
+	deu_tune_algs(deu->dev);
+
+unlock:
+	mutex_unlock(&deu_devs_lock);
+
+	if (err)
+		synchronize_rcu();
+
+	return err;
+}
+
+/* Stop dispatching to the instance; the last one takes the algorithms */
+static void deu_dev_del(struct deu_dev *deu)
+{
+	mutex_lock(&deu_devs_lock);
+
+	if (list_is_singular(&deu_devs)) {
+		WRITE_ONCE(deu_algs_registered, false);
+		deu_unregister_algs(ARRAY_SIZE(deu_algs));
+	}
+
+	list_del_rcu(&deu->list);
+
+	mutex_unlock(&deu_devs_lock);
+
+	synchronize_rcu();
+}
+
 static int ltq_deu_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
+	struct deu_dev *deu;
 	struct resource *res;
-	__iomem void *base;
+	char name[16];
 	int err;
 
-	platform_set_drvdata(pdev, dev);
+	deu = devm_kzalloc(dev, sizeof(*deu), GFP_KERNEL);
+	if (!deu)
+		return -ENOMEM;
+
+	deu->dev = dev;
+	deu->dispatch = true;
+	deu->irq = -ENXIO;
+	platform_set_drvdata(pdev, deu);
+
+	if (deu_model_enabled()) {
+		deu->base = deu_model_init(dev);
+		if (!deu->base)
+			return -ENOMEM;
+		deu->model = true;
+		goto start;
+	}
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!res) {
@@ -181,31 +1277,92 @@ static int ltq_deu_probe(struct platform_device *pdev)
 		return -EBUSY;
 	}
 
-	base = devm_ioremap(&pdev->dev, res->start, resource_size(res));
+	deu->base = devm_ioremap(&pdev->dev, res->start, resource_size(res));
 
-	if (!base) {
+	if (!deu->base) {
 		dev_err(&pdev->dev, "failed to remap deu engine %d\n",
 			pdev->id);
 		return -ENOMEM;
 	}
-	ltq_deu_start(base);
 
-	err = deu_register_algs();
+start:
+	deu->irq = platform_get_irq_optional(pdev, 0);
+	if (deu->irq > 0) {
+		err = devm_request_irq(dev, deu->irq, ltq_deu_irq_handler,
+					IRQF_SHARED, dev_name(dev), deu);
+		if (err) {
+			dev_warn(dev, "irq %d unavailable, polling only\n",
+				deu->irq);
+			deu->irq = -ENXIO;
+		}
+	}
+
+	deu->id = ida_alloc(&deu_ida, GFP_KERNEL);
+	if (deu->id < 0)
+		return deu->id;
+
+	snprintf(name, sizeof(name), "deu%d", deu->id);
+	deu->debugfs = debugfs_create_dir(name, deu_debugfs_root);
+	debugfs_create_bool("dispatch", 0644, deu->debugfs, &deu->dispatch);
+
+	deu_units_setup(deu);
+
+	ltq_deu_start(deu);
+
+	err = deu_dma_init(deu);
+	if (err) {
+		dev_err(dev, "failed to set up DMA\n");
+		goto err_stop;
+	}
+
+	err = deu_units_init(deu);
 	if (err)
-		return err;
+		goto err_dma;
 
-	dev_info(&pdev->dev, "Data Encryption Unit initialized.\n");
+	err = deu_dev_add(deu);
+	if (err)
+		goto err_engine;
+
+	dev_info(&pdev->dev, "Data Encryption Unit %d initialized.\n",
+		deu->id);
 
 	return 0;
+
+err_engine:
+	debugfs_remove_recursive(deu->debugfs);
+	deu->debugfs = NULL;
+	deu_units_exit(deu);
+err_dma:
+	deu_dma_exit(deu);
+err_stop:
+	ltq_deu_stop(deu);
+	debugfs_remove_recursive(deu->debugfs);
+	ida_free(&deu_ida, deu->id);
+
+	return err;
 }
 
 static int ltq_deu_remove(struct platform_device *pdev)
 {
-	deu_unregister_algs(ARRAY_SIZE(deu_algs));
+	struct deu_dev *deu = platform_get_drvdata(pdev);
+
+	deu_dev_del(deu);
+
+	/* requests picked before the instance left the list */
+	deu_units_drain(deu);
+
+	/* the stats files point at per-CPU counters freed below */
+	debugfs_remove_recursive(deu->debugfs);
 
-	ltq_deu_stop();
+	deu_units_exit(deu);
 
-	dev_info(&pdev->dev, "Date Encryption Unit removed.\n");
+	deu_dma_exit(deu);
+
+	ltq_deu_stop(deu);
+
+	ida_free(&deu_ida, deu->id);
+
+	dev_info(&pdev->dev, "Date Encryption Unit %d removed.\n", deu->id);
 
 	return 0;
 }
@@ -225,10 +1382,70 @@ static struct platform_driver ltq_deu_driver = {
 	.remove = ltq_deu_remove,
 	.driver = {
 		.name = "deu",
-		.of_match_table = ltq_deu_match,
+		.of_match_table = of_match_ptr(ltq_deu_match),
 	},
 };
-module_platform_driver(ltq_deu_driver);
+
+static struct platform_device *ltq_deu_model_pdevs[DEU_MODEL_MAX];
+
+static void ltq_deu_model_unregister(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < DEU_MODEL_MAX; i++) {
+		if (!IS_ERR_OR_NULL(ltq_deu_model_pdevs[i]))
+			platform_device_unregister(ltq_deu_model_pdevs[i]);
+		ltq_deu_model_pdevs[i] = NULL;
+	}
+}
+
+static int __init ltq_deu_init(void)
+{
+	struct platform_device *pdev;
+	unsigned int i;
+	int err;
+
+	deu_debugfs_root = debugfs_create_dir(KBUILD_MODNAME, NULL);
+
+	err = platform_driver_register(&ltq_deu_driver);
+	if (err)
+		goto err_debugfs;
+
+	/* without a devicetree node the register model needs devices */
+	if (!deu_model_enabled() || !list_empty(&deu_devs))
+		return 0;
+
+	for (i = 0; i < deu_model_instances(); i++) {
+		pdev = platform_device_register_simple("deu",
+					PLATFORM_DEVID_AUTO, NULL, 0);
+		if (IS_ERR(pdev)) {
+			err = PTR_ERR(pdev);
+			goto err_model;
+		}
+		ltq_deu_model_pdevs[i] = pdev;
+	}
+
+	return 0;
+
+err_model:
+	ltq_deu_model_unregister();
+	platform_driver_unregister(&ltq_deu_driver);
+err_debugfs:
+	debugfs_remove_recursive(deu_debugfs_root);
+
+	return err;
+}
+module_init(ltq_deu_init);
+
+static void __exit ltq_deu_exit(void)
+{
+	ltq_deu_model_unregister();
+
+	platform_driver_unregister(&ltq_deu_driver);
+
+	debugfs_remove_recursive(deu_debugfs_root);
+}
+module_exit(ltq_deu_exit);
 
 MODULE_AUTHOR("Richard van Schagen <vschagen@icloud.com>");
 MODULE_ALIAS("platform:" KBUILD_MODNAME);
@@ -7,10 +7,22 @@
 #ifndef _DEU_CORE_H_
 #define _DEU_CORE_H_
 
+#include <crypto/engine.h>
+#include <crypto/internal/aead.h>
 #include <crypto/internal/hash.h>
 #include <crypto/internal/skcipher.h>
+#include <linux/completion.h>
+#include <linux/io.h>
+#include <linux/list.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <asm/unaligned.h>
 
 #define DEU_CRA_PRIORITY	400
+#define DEU_QUEUE_LEN		128
+#define DEU_POLL_HIST		8
+#define DEU_SIZE_HIST		16	/* log2 request size, 16 KB and up last */
+#define DEU_LAT_HIST		20	/* log2 microseconds, 2^18 us and up last */
 #define PMU_DEU			BIT(20)
 
 union clk_control {
@@ -26,20 +38,274 @@ union clk_control {
 	} bits;
 } __packed;
 
+/* BUS sits in the same place in the AES and DES control registers */
+union deu_status {
+	u32	word;
+	struct {
+		u32 Res1:24;
+		u32 BUS:1;
+		u32 Res2:7;
+	} bits;
+} __packed;
+
+/* Longest register run moved at once, an AES-256 key */
+#define DEU_REGS_MAX		8
+
+/*
+ * The data, key and IV registers of the AES and DES units sit at
+ * ascending addresses in the order the words are taken, with the one
+ * that starts the engine (ID0R, ILR) last, so a block, IV or key is one
+ * run of __raw accesses in address order. This is __iowrite32_copy()
+ * and __ioread32_copy() inlined, so the fixed counts unroll instead of
+ * costing a call per block. There is no byte swap: aes_init_hw() and
+ * des_init_hw() set ENDI/NDC so the units take the words as the CPU
+ * holds them, never use the swapping ioread32()/iowrite32() here.
+ * Buffers may sit at any alignment, misaligned ones go through a copy.
+ */
+static inline void deu_regs_write(void __iomem *reg, const void *src,
+			unsigned int words)
+{
+	u32 __iomem *dst = reg;
+	u32 buf[DEU_REGS_MAX];
+	const u32 *p = src;
+	unsigned int i;
+
+	if (!IS_ALIGNED((unsigned long)src, sizeof(u32))) {
+		for (i = 0; i < words; i++)
+			buf[i] = get_unaligned(&p[i]);
+		p = buf;
+	}
+
+	for (i = 0; i < words; i++)
+		__raw_writel(p[i], &dst[i]);
+}
+
+static inline void deu_regs_read(void *dst, const void __iomem *reg,
+			unsigned int words)
+{
+	const u32 __iomem *src = reg;
+	u32 *p = dst;
+	unsigned int i;
+
+	if (IS_ALIGNED((unsigned long)dst, sizeof(u32))) {
+		for (i = 0; i < words; i++)
+			p[i] = __raw_readl(&src[i]);
+		return;
+	}
+
+	for (i = 0; i < words; i++)
+		put_unaligned(__raw_readl(&src[i]), &p[i]);
+}
+
+struct deu_unit;
+struct deu_dev;
+struct deu_dma;
+
+/*
+ * Performance counters of an algorithm or a unit, one copy per CPU so
+ * the hot path only touches local cache lines. Summed when read.
+ */
+struct deu_stats {
+	u64	requests;
+	u64	bytes;
+	u64	walks;		/* walk / scatterlist steps */
+	u64	key_loads;
+	u64	wait_ns;	/* spinning for the unit lock */
+	u64	hold_ns;	/* unit lock held, IRQs off */
+	u64	polls;		/* extra BUS reads */
+	u64	size_hist[DEU_SIZE_HIST];
+	u64	lat_hist[DEU_LAT_HIST];	/* algorithms only */
+};
+
+/* Add n to field of the unit's and, if given, the algorithm's counters */
+#define deu_stat_add(unit, tmpl, field, n)				\
+	do {								\
+		this_cpu_add((unit)->stats->field, n);			\
+		if (tmpl)						\
+			this_cpu_add((tmpl)->stats->field, n);		\
+	} while (0)
+
+/* Protected by the unit lock */
+struct deu_unit_stats {
+	u64	sec_polls;	/* polls of the current lock hold */
+	u64	blocks;
+	u64	polls;
+	u64	slow;
+	u64	timeouts;
+	u32	max_polls;
+	u64	hist[DEU_POLL_HIST];
+	u64	holds;
+	u64	hold_ns;
+	u64	hold_max_ns;
+	u64	parks;		/* waits with the lock dropped */
+	u64	sec_park_ns;	/* parked in the current lock hold */
+};
+
 enum deu_alg_type {
 	DEU_ALG_TYPE_AHASH,
 	DEU_ALG_TYPE_SHASH,
 	DEU_ALG_TYPE_SKCIPHER,
+	DEU_ALG_TYPE_AEAD,
+};
+
+/* Direction of a request in trace events, cipher callers pass enc */
+enum deu_op {
+	DEU_OP_DEC,
+	DEU_OP_ENC,
+	DEU_OP_HASH,
+};
+
+/* Where a request was processed */
+enum deu_path {
+	DEU_PATH_HW,
+	DEU_PATH_SW_SMALL,
+	DEU_PATH_SW_BUSY,
+	DEU_PATH_NUM,
 };
 
 struct deu_alg_template {
 	enum deu_alg_type	type;
 	int			mode;
+	unsigned int		sw_threshold;	/* smaller requests: software */
+	atomic_long_t		paths[DEU_PATH_NUM];
+	struct deu_stats __percpu *stats;
 	union {
 		struct ahash_alg	ahash;
 		struct shash_alg	shash;
 		struct skcipher_alg	skcipher;
+		struct aead_alg		aead;
 	} alg;
 };
 
+/* Most requests the engine worker collects into one unit session */
+#define DEU_BATCH_MAX		16
+
+typedef void (*deu_batch_fn)(struct deu_unit *unit,
+			struct crypto_async_request **reqs, unsigned int n);
+
+enum deu_unit_id {
+	DEU_UNIT_DES,
+	DEU_UNIT_AES,
+	DEU_UNIT_HASH,
+	DEU_UNIT_NUM,
+};
+
+/*
+ * Each hardware unit has its own engine queue and worker, so AES, DES
+ * and hash requests run on the DEU at the same time. The batch is only
+ * touched from the unit's worker. The lock covers the registers and
+ * the fields marked with it. owned is set while the unit is driven
+ * without the lock held, by a DMA transfer, a waiter parked in
+ * deu_wait_ready() or an authenc request (deu_unit_claim()):
+ * deu_unit_lock() waits for it to clear, atomic callers do their work
+ * in software instead.
+ */
+struct deu_unit {
+	const char			*name;
+	enum deu_unit_id		id;
+	bool				enabled;
+	struct deu_dev			*deu;
+	void __iomem			*base;		/* CTRL first */
+	spinlock_t			lock;
+	u32				ctrl;		/* lock, CTRL shadow */
+	u32				ctrl_hw;	/* lock, last written */
+	struct deu_unit_stats		lstats;		/* lock */
+	const void			*resident_key;	/* lock */
+	u32				resident_gen;	/* lock */
+	bool				owned;		/* lock, see below */
+	unsigned long			*irqflags;	/* lock, holder may park */
+	bool				may_sleep;	/* lock, ... and sleep */
+	struct deu_unit			*pair;		/* lock, authenc section */
+	bool				irq_wait;
+	struct completion		done;		/* BUS cleared, by IRQ */
+	struct crypto_engine		*engine;
+	atomic_t			inflight;
+	deu_batch_fn			batch_run;
+	unsigned int			batch_n;
+	struct crypto_async_request	*batch[DEU_BATCH_MAX];
+	unsigned long			batch_runs;
+	unsigned long			batch_reqs;
+	struct deu_stats __percpu	*stats;
+};
+
+/*
+ * One bound DEU. The algorithms are registered once for all of them and
+ * every request is handed to the least loaded instance that has
+ * dispatch set, see deu_get_unit().
+ */
+struct deu_dev {
+	struct device		*dev;
+	struct list_head	list;		/* deu_devs, RCU */
+	int			id;
+	void __iomem		*base;
+	bool			model;		/* software register model */
+	bool			dispatch;	/* takes new requests */
+	int			irq;
+	struct deu_dma		*dma;
+	struct dentry		*debugfs;
+	struct deu_unit		units[DEU_UNIT_NUM];
+};
+
+/*
+ * CTRL is never read-modify-written: the bitfields of a request are set
+ * in the shadow unit->ctrl and deu_ctrl_flush() writes the whole word
+ * with one __raw_writel() before the unit is started, skipped when the
+ * unit already has it. Trigger bits the unit clears by itself (PNK,
+ * INIT) are named in self_clear and dropped from the shadow once
+ * written. Status bits (BUS, KV) stay zero in it, the unit ignores
+ * writes to them. Unit lock held.
+ */
+static inline void deu_ctrl_flush(struct deu_unit *unit, u32 self_clear)
+{
+	if (unit->ctrl == unit->ctrl_hw)
+		return;
+
+	__raw_writel(unit->ctrl, unit->base);
+	unit->ctrl &= ~self_clear;
+	unit->ctrl_hw = unit->ctrl;
+}
+
+/* Start the shadow from the unit's reset value, done once at init */
+static inline void deu_ctrl_init(struct deu_unit *unit, u32 status)
+{
+	unit->ctrl = __raw_readl(unit->base) & ~status;
+	unit->ctrl_hw = unit->ctrl;
+}
+
+struct deu_alg_template *deu_alg_iter(unsigned int *pos);
+const char *deu_alg_name(struct deu_alg_template *tmpl);
+u32 deu_next_key_gen(void);
+struct deu_unit *deu_get_unit(enum deu_unit_id id);
+void deu_put_unit(struct deu_unit *unit);
+struct deu_unit *deu_claim_engine(enum deu_unit_id id,
+			struct deu_alg_template *tmpl, unsigned int nbytes,
+			int op);
+int deu_batch_add(struct deu_unit *unit, struct crypto_async_request *req,
+			deu_batch_fn run);
+void deu_batch_flush(struct deu_unit *unit);
+unsigned int deu_chunk_blocks(void);
+void deu_stat_request(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			unsigned int nbytes, int op);
+void deu_stat_walk(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			unsigned int nbytes, int op);
+void deu_stat_key_load(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			unsigned int keylen);
+void deu_stat_done(struct deu_alg_template *tmpl, u64 queued,
+			unsigned int nbytes, int op, int err);
+u64 deu_lock_taken(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			u64 wait);
+void deu_account_hold(struct deu_unit *unit, struct deu_alg_template *tmpl,
+			u64 wait, u64 start);
+void deu_unit_lock(struct deu_unit *unit, unsigned long *flags,
+			bool may_sleep);
+bool deu_unit_trylock(struct deu_unit *unit, unsigned long *flags);
+void deu_unit_unlock(struct deu_unit *unit, unsigned long *flags);
+void deu_unit_claim(struct deu_unit *unit);
+void deu_unit_release(struct deu_unit *unit);
+void deu_unit_lock_pair(struct deu_unit *unit, struct deu_unit *hu,
+			unsigned long *flags);
+void deu_unit_unlock_pair(struct deu_unit *unit, struct deu_unit *hu,
+			unsigned long *flags);
+int deu_wait_ready(struct deu_unit *unit);
+
 #endif /* _DEU_CORE_H_ */
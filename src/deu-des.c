@@ -12,99 +12,384 @@
  * Copyright (C) 2021 Richard van Schagen <vschagen@icloud.com>
  */
 
+#include <crypto/authenc.h>
 #include <crypto/ctr.h>
 #include <crypto/scatterwalk.h>
+#include <linux/sched/clock.h>
+#include <linux/timekeeping.h>
 #include <linux/spinlock.h>
+#include <asm/unaligned.h>
 
 #include "deu-core.h"
 #include "deu-des.h"
+#include "deu-dma.h"
 
-static void __iomem *ltq_des_membase;
-static DEFINE_SPINLOCK(ltq_des_lock);
+/* The shadowed CTRL, see deu_ctrl_flush() */
+#define des_ctrl(unit)	((union des_control *)&(unit)->ctrl)
+
+static const union des_control des_ctrl_status = {
+	.bits = { .BUS = 1 },
+};
+
+/* DES has no self-clearing CTRL bits */
+static inline void des_ctrl_flush(struct deu_unit *unit)
+{
+	deu_ctrl_flush(unit, 0);
+}
 
 // Init DES Engine (vr9) TODO!
-void des_init_hw(__iomem void *base)
+void des_init_hw(struct deu_unit *unit, __iomem void *base)
 {
-	ltq_des_membase = base + 0x10;
+	unit->base = base + DEU_DES_BASE;
+	unit->resident_key = NULL;
 
 	if (base) {
-		struct des_t *des = (struct des_t *)ltq_des_membase;
+		union des_control *ctrl = des_ctrl(unit);
 
+		deu_ctrl_init(unit, des_ctrl_status.word);
 		// start crypto engine with write to ILR
-		des->CTRL.bits.SM = 1;
-		des->CTRL.bits.NDC = 1;
-		wmb();
-		des->CTRL.bits.ENDI = 1;
+		ctrl->bits.SM = 1;
+		/* no byte swap, deu_regs_write() relies on it */
+		ctrl->bits.NDC = 1;
+		des_ctrl_flush(unit);
 		wmb();
-		des->CTRL.bits.ARS = 0;
+		ctrl->bits.ENDI = 1;
+		ctrl->bits.ARS = 0;
+		des_ctrl_flush(unit);
 		wmb();
 	}
 }
 
-static inline void des_set_key_hw(struct deu_des_ctx *ctx)
+/* Written to the unit with the rest of CTRL by des_ctrl_flush() */
+static inline void des_set_key_hw(struct deu_unit *unit,
+			struct deu_des_ctx *ctx)
 {
-	struct des_t *des = (struct des_t *)ltq_des_membase;
-	u32 *key = ctx->key;
-	u32 *keyreg = &des->K1HR;
+	struct des_t *des = (struct des_t *)unit->base;
 	int keywords;
-	int i;
 
-	des->CTRL.bits.M =  ctx->keylen;
+	if (ctx == unit->resident_key && ctx->key_gen == unit->resident_gen)
+		return;
+
+	des_ctrl(unit)->bits.M = ctx->keylen;
 	if (ctx->keylen == 0) // 0 for des
 		keywords = 2;
 	else
 		keywords = (ctx->keylen - 1) * 2;
 
-	for (i = 0; i < keywords; i++)
-		keyreg[i] = key[i];
+	deu_regs_write(&des->K1HR, ctx->key, keywords);
+
+	unit->resident_key = ctx;
+	unit->resident_gen = ctx->key_gen;
+
+	deu_stat_key_load(unit, ctx->tmpl, keywords * 4);
 }
 
-static void deu_transform_block(struct deu_des_ctx *ctx, u32 *iv, u8 *out_arg,
-			const u8 *in_arg, size_t nbytes, int mode, bool enc)
+static int des_transform_chunk(struct deu_unit *unit, struct deu_des_ctx *ctx,
+			u32 *iv, u8 *out_arg, const u8 *in_arg, size_t nbytes,
+			int mode, bool enc)
 {
-	struct des_t *des = (struct des_t *)ltq_des_membase;
-	union des_control desc;
+	struct des_t *des = (struct des_t *)unit->base;
 	const u32 *in = (u32 *)in_arg;
 	u32 *out = (u32 *)out_arg;
+	u32 next[DES_BLOCK_SIZE / 4];
+	u32 res[DES_BLOCK_SIZE / 4];
+	bool pending = false;
 	unsigned long flag;
-	int i = 0;
+	int i = 0, j = 0;
+	int err = 0;
+	u64 wait, start;
+
+	wait = local_clock();
+	deu_unit_lock(unit, &flag, false);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
 
-	spin_lock_irqsave(&ltq_des_lock, flag);
+	des_set_key_hw(unit, ctx);
 
-	des_set_key_hw(ctx);
+	des_ctrl(unit)->bits.E_D = !enc;
+	des_ctrl(unit)->bits.O = mode;
+	des_ctrl_flush(unit);
 
-	des->CTRL.bits.E_D = !enc;
-	des->CTRL.bits.O = mode;
+	if (iv)
+		deu_regs_write(&des->IVHR, iv, DES_BLOCK_SIZE / 4);
 
-	if (iv) {
-		des->IVHR = iv[0];
-		des->IVLR = iv[1];
-	};
+	next[0] = get_unaligned(&in[0]);
+	next[1] = get_unaligned(&in[1]);
 
+	/* same pipeline as AES: the ILR write starts the engine, any alignment */
 	while (nbytes) {
-		des->IHR = in[i + 0];
-		des->ILR = in[i + 1];
+		deu_regs_write(&des->IHR, next, DES_BLOCK_SIZE / 4);
 
-		do {
-			desc.word = __raw_readl(ltq_des_membase);
-		} while (desc.bits.BUS);
+		nbytes -= DES_BLOCK_SIZE;
 
-		out[i + 0] = des->OHR;
-		out[i + 1] = des->OLR;
+		if (pending) {
+			put_unaligned(res[0], &out[j + 0]);
+			put_unaligned(res[1], &out[j + 1]);
+			j += (DES_BLOCK_SIZE / 4);
+		}
 
-		nbytes -= DES_BLOCK_SIZE;
-		i += (DES_BLOCK_SIZE / 4);
+		if (nbytes) {
+			i += (DES_BLOCK_SIZE / 4);
+			next[0] = get_unaligned(&in[i + 0]);
+			next[1] = get_unaligned(&in[i + 1]);
+		}
+
+		err = deu_wait_ready(unit);
+		if (err)
+			break;
+
+		deu_regs_read(res, &des->OHR, DES_BLOCK_SIZE / 4);
+		pending = true;
+	}
+
+	if (!err) {
+		put_unaligned(res[0], &out[j + 0]);
+		put_unaligned(res[1], &out[j + 1]);
+	}
+
+	if (iv)
+		deu_regs_read(iv, &des->IVHR, DES_BLOCK_SIZE / 4);
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	return err;
+}
+
+static int deu_transform_block(struct deu_unit *unit, struct deu_des_ctx *ctx,
+			u32 *iv, u8 *out, const u8 *in, size_t nbytes, int mode,
+			bool enc)
+{
+	size_t chunk, max = deu_chunk_blocks() * DES_BLOCK_SIZE;
+	int err = 0;
+
+	while (nbytes && !err) {
+		chunk = min(nbytes, max);
+		err = des_transform_chunk(unit, ctx, iv, out, in, chunk, mode,
+					enc);
+		out += chunk;
+		in += chunk;
+		nbytes -= chunk;
+	}
+
+	return err;
+}
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+/* CBC on the DES unit with the hash unit fed alongside, see deu-aes.c */
+static int des_authenc_chunk(struct deu_unit *unit, struct deu_des_ctx *ctx,
+			struct deu_hash_stream *hs, u32 *iv, u8 *out,
+			const u8 *in, size_t nbytes, bool enc)
+{
+	struct deu_unit *hu = &unit->deu->units[DEU_UNIT_HASH];
+	struct des_t *des = (struct des_t *)unit->base;
+	const u32 *src = (const u32 *)in;
+	u32 *dst = (u32 *)out;
+	unsigned long flag;
+	size_t i, j;
+	int err = 0;
+	u64 wait, start;
+
+	/* both units of the same instance, the DES lock always first */
+	wait = local_clock();
+	deu_unit_lock_pair(unit, hu, &flag);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	des_set_key_hw(unit, ctx);
+
+	des_ctrl(unit)->bits.E_D = !enc;
+	des_ctrl(unit)->bits.O = MODE_CBC;
+	des_ctrl_flush(unit);
+
+	deu_regs_write(&des->IVHR, iv, DES_BLOCK_SIZE / 4);
+
+	deu_hash_begin_locked(hu, hs);
+
+	for (i = 0; i < nbytes; i += DES_BLOCK_SIZE) {
+		j = i / 4;
+
+		deu_regs_write(&des->IHR, &src[j], DES_BLOCK_SIZE / 4);
+
+		if (!enc)
+			err = deu_hash_feed_locked(hu, hs, in + i,
+						DES_BLOCK_SIZE);
+		else if (i)
+			err = deu_hash_feed_locked(hu, hs,
+						out + i - DES_BLOCK_SIZE,
+						DES_BLOCK_SIZE);
+		if (!err)
+			err = deu_wait_ready(unit);
+		if (err)
+			goto out;
+
+		deu_regs_read(&dst[j], &des->OHR, DES_BLOCK_SIZE / 4);
+	}
+
+	if (enc)
+		err = deu_hash_feed_locked(hu, hs,
+					out + nbytes - DES_BLOCK_SIZE,
+					DES_BLOCK_SIZE);
+	if (!err)
+		err = deu_hash_end_locked(hu, hs);
+
+	deu_regs_read(iv, &des->IVHR, DES_BLOCK_SIZE / 4);
+
+out:
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_hash_account_locked(hu, ctx->tmpl, wait, start);
+	deu_unit_unlock_pair(unit, hu, &flag);
+
+	return err;
+}
+
+static int deu_authenc_transform(struct deu_unit *unit, struct deu_des_ctx *ctx,
+			struct deu_hash_stream *hs, u32 *iv, u8 *out,
+			const u8 *in, size_t nbytes, bool enc)
+{
+	size_t chunk, max = deu_chunk_blocks() * DES_BLOCK_SIZE;
+	int err = 0;
+
+	while (nbytes && !err) {
+		chunk = min(nbytes, max);
+		err = des_authenc_chunk(unit, ctx, hs, iv, out, in, chunk, enc);
+		out += chunk;
+		in += chunk;
+		nbytes -= chunk;
+	}
+
+	return err;
+}
+
+/* authenc(hmac(sha1),cbc(des3_ede)): encrypt-then-MAC */
+static int deu_aead_authenc_crypt(struct deu_unit *unit,
+			struct aead_request *req, bool enc)
+{
+	struct deu_unit *hu = &unit->deu->units[DEU_UNIT_HASH];
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct deu_des_ctx *ctx = crypto_aead_ctx(tfm);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	unsigned int cryptlen = req->cryptlen;
+	struct deu_hash_stream hs;
+	struct skcipher_walk walk;
+	u8 tag[SHA1_DIGEST_SIZE];
+	u8 buf[SHA1_DIGEST_SIZE];
+	unsigned int nbytes;
+	int err;
+
+	if (!enc)
+		cryptlen -= authsize;
+
+	if (cryptlen % DES_BLOCK_SIZE)
+		return -EINVAL;
+
+	deu_hash_stream_init(&hs, HASH_ALGM_SHA1, ctx->hmac.istate,
+				DEU_HASH_BLOCK_SIZE);
+	hs.tmpl = ctx->tmpl;
+	err = deu_hash_stream_update_sg(hu, &hs, req->src, req->assoclen);
+	if (err)
+		return err;
+
+	/* the walk steps cannot wait for the hash unit, own it meanwhile */
+	deu_unit_claim(hu);
+	if (enc)
+		err = skcipher_walk_aead_encrypt(&walk, req, false);
+	else
+		err = skcipher_walk_aead_decrypt(&walk, req, false);
+
+	while ((nbytes = walk.nbytes)) {
+		err = deu_authenc_transform(unit, ctx, &hs, (u32 *)walk.iv,
+				walk.dst.virt.addr, walk.src.virt.addr,
+				nbytes, enc);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			break;
+		}
+
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
+		err = skcipher_walk_done(&walk, 0);
 	}
+	deu_unit_release(hu);
+	if (err)
+		return err;
 
-	if (iv) {
-		iv[0] = des->IVHR;
-		iv[1] = des->IVLR;
+	err = deu_hmac_final(hu, &hs, &ctx->hmac, tag);
+	if (err)
+		return err;
+
+	if (enc) {
+		scatterwalk_map_and_copy(tag, req->dst,
+				req->assoclen + cryptlen, authsize, 1);
+		return 0;
 	}
 
-	spin_unlock_irqrestore(&ltq_des_lock, flag);
+	scatterwalk_map_and_copy(buf, req->src, req->assoclen + cryptlen,
+				authsize, 0);
+
+	return crypto_memneq(tag, buf, authsize) ? -EBADMSG : 0;
 }
+#endif
 
-static int deu_skcipher_crypt(struct skcipher_request *req, int mode, bool enc)
+static int deu_des_dma_crypt(struct deu_unit *unit, struct deu_des_ctx *ctx,
+			struct skcipher_request *req, int mode, bool enc)
+{
+	struct des_t *des = (struct des_t *)unit->base;
+	u32 iv[DES_BLOCK_SIZE / 4];
+	unsigned long flag;
+	int err;
+	u64 wait, start;
+
+	if (mode > 0)
+		memcpy(iv, req->iv, DES_BLOCK_SIZE);
+
+	wait = local_clock();
+	deu_unit_lock(unit, &flag, false);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	des_set_key_hw(unit, ctx);
+
+	des_ctrl(unit)->bits.E_D = !enc;
+	des_ctrl(unit)->bits.O = mode;
+	des_ctrl_flush(unit);
+
+	if (mode > 0)
+		deu_regs_write(&des->IVHR, iv, DES_BLOCK_SIZE / 4);
+
+	/* DMA feeds IHR/ILR and drains OHR/OLR, restart on every block */
+	des_ctrl(unit)->bits.DAU = 1;
+	des_ctrl(unit)->bits.ARS = 1;
+	des_ctrl_flush(unit);
+	unit->owned = true;
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	deu_unit_unlock(unit, &flag);
+
+	/* only the engine worker drives the unit, it stays ours meanwhile */
+	err = deu_dma_transfer(unit, DEU_DMA_ALGO_DES, req->src, req->dst,
+				req->cryptlen);
+
+	/* still owned by us, so not deu_unit_lock() */
+	wait = local_clock();
+	spin_lock_irqsave(&unit->lock, flag);
+	start = deu_lock_taken(unit, ctx->tmpl, wait);
+
+	des_ctrl(unit)->bits.ARS = 0;
+	des_ctrl(unit)->bits.DAU = 0;
+	des_ctrl_flush(unit);
+	unit->owned = false;
+
+	if (mode > 0)
+		deu_regs_read(iv, &des->IVHR, DES_BLOCK_SIZE / 4);
+
+	deu_account_hold(unit, ctx->tmpl, wait, start);
+	spin_unlock_irqrestore(&unit->lock, flag);
+
+	if (mode > 0)
+		memcpy(req->iv, iv, DES_BLOCK_SIZE);
+
+	return err;
+}
+
+static int deu_skcipher_crypt(struct deu_unit *unit,
+			struct skcipher_request *req, int mode, bool enc)
 {
 	struct deu_des_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
 	struct skcipher_walk walk;
@@ -112,6 +397,10 @@ static int deu_skcipher_crypt(struct skcipher_request *req, int mode, bool enc)
 	u32 *iv = NULL;
 	int err;
 
+	if (deu_dma_capable(unit, req->src, req->dst, req->cryptlen,
+				DES_BLOCK_SIZE))
+		return deu_des_dma_crypt(unit, ctx, req, mode, enc);
+
 	err = skcipher_walk_virt(&walk, req, false);
 
 	if (mode > 0)
@@ -121,9 +410,14 @@ static int deu_skcipher_crypt(struct skcipher_request *req, int mode, bool enc)
 				&& (walk.nbytes >= DES_BLOCK_SIZE)) {
 		blk_bytes -= (nbytes % DES_BLOCK_SIZE);
 
-		deu_transform_block(ctx, iv, walk.dst.virt.addr,
+		err = deu_transform_block(unit, ctx, iv, walk.dst.virt.addr,
 				walk.src.virt.addr, blk_bytes, mode, enc);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
 		nbytes &= DES_BLOCK_SIZE - 1;
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
 		err = skcipher_walk_done(&walk, nbytes);
 	}
 	/* For stream ciphers handle last block
@@ -133,10 +427,15 @@ static int deu_skcipher_crypt(struct skcipher_request *req, int mode, bool enc)
 		u8 buf[DES_BLOCK_SIZE];
 
 		memcpy(&buf, walk.src.virt.addr, nbytes);
-		deu_transform_block(ctx, iv, buf, buf,
+		err = deu_transform_block(unit, ctx, iv, buf, buf,
 						DES_BLOCK_SIZE, mode, enc);
+		if (err) {
+			skcipher_walk_done(&walk, err);
+			return err;
+		}
 
 		memcpy(walk.dst.virt.addr, &buf, nbytes);
+		deu_stat_walk(unit, ctx->tmpl, walk.nbytes, enc);
 		err = skcipher_walk_done(&walk, 0);
 	}
 
@@ -144,6 +443,18 @@ static int deu_skcipher_crypt(struct skcipher_request *req, int mode, bool enc)
 }
 
 /* Crypto API */
+static int deu_skcipher_fallback_setkey(struct crypto_skcipher *tfm,
+				const u8 *key, unsigned int len)
+{
+	struct deu_des_ctx *ctx = crypto_skcipher_ctx(tfm);
+
+	crypto_skcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_skcipher_set_flags(ctx->fallback, crypto_skcipher_get_flags(tfm) &
+						CRYPTO_TFM_REQ_MASK);
+
+	return crypto_skcipher_setkey(ctx->fallback, key, len);
+}
+
 static int deu_skcipher_des_setkey(struct crypto_skcipher *tfm, const u8 *key,
 			unsigned int len)
 {
@@ -157,8 +468,9 @@ static int deu_skcipher_des_setkey(struct crypto_skcipher *tfm, const u8 *key,
 
 	ctx->keylen = 0; // this indicates DES
 	memcpy(&ctx->key, key, len);
+	ctx->key_gen = deu_next_key_gen();
 
-	return 0;
+	return deu_skcipher_fallback_setkey(tfm, key, len);
 }
 
 static int deu_skcipher_3des_setkey(struct crypto_skcipher *tfm,
@@ -174,26 +486,268 @@ static int deu_skcipher_3des_setkey(struct crypto_skcipher *tfm,
 
 	ctx->keylen = len / 8 + 1;
 	memcpy(&ctx->key, key, len);
+	ctx->key_gen = deu_next_key_gen();
+
+	return deu_skcipher_fallback_setkey(tfm, key, len);
+}
+
+static int deu_skcipher_do_one(struct crypto_engine *engine, void *areq)
+{
+	struct skcipher_request *req = skcipher_request_cast(areq);
+	struct deu_des_reqctx *rctx = skcipher_request_ctx(req);
+	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.skcipher.base);
+	struct deu_unit *unit = engine->priv_data;
+	int err;
+
+	deu_batch_flush(unit);
+
+	err = deu_skcipher_crypt(unit, req, tmpl->mode, rctx->enc);
+
+	deu_put_unit(unit);
+	deu_stat_done(tmpl, rctx->queued, req->cryptlen, rctx->enc, err);
+	crypto_finalize_skcipher_request(engine, req, err);
 
 	return 0;
 }
 
-static int deu_skcipher_encrypt(struct skcipher_request *req)
+/* Small requests are cheaper in software than lock, key and MMIO setup */
+static int deu_skcipher_fallback(struct skcipher_request *req, bool enc)
 {
+	struct deu_des_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct deu_des_reqctx *rctx = skcipher_request_ctx(req);
+	struct skcipher_request *subreq = &rctx->fallback_req;
+
+	skcipher_request_set_tfm(subreq, ctx->fallback);
+	skcipher_request_set_callback(subreq, req->base.flags,
+				req->base.complete, req->base.data);
+	skcipher_request_set_crypt(subreq, req->src, req->dst,
+				req->cryptlen, req->iv);
+
+	return enc ? crypto_skcipher_encrypt(subreq) :
+			crypto_skcipher_decrypt(subreq);
+}
+
+static int deu_skcipher_queue(struct skcipher_request *req, bool enc)
+{
+	struct deu_des_reqctx *rctx = skcipher_request_ctx(req);
 	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
 				struct deu_alg_template, alg.skcipher.base);
+	struct deu_unit *unit;
+	int err;
+
+	unit = deu_claim_engine(DEU_UNIT_DES, tmpl, req->cryptlen, enc);
+	if (!unit)
+		return deu_skcipher_fallback(req, enc);
 
-	return deu_skcipher_crypt(req, tmpl->mode, true);
+	rctx->enc = enc;
+	rctx->queued = ktime_get_ns();
+
+	err = crypto_transfer_skcipher_request_to_engine(unit->engine,
+						req);
+	if (err == -ENOSPC)
+		deu_put_unit(unit);
+
+	return err;
+}
+
+static int deu_skcipher_encrypt(struct skcipher_request *req)
+{
+	return deu_skcipher_queue(req, true);
 }
 
 static int deu_skcipher_decrypt(struct skcipher_request *req)
 {
+	return deu_skcipher_queue(req, false);
+}
+
+static int deu_skcipher_init_tfm(struct crypto_skcipher *tfm)
+{
+	struct deu_des_ctx *ctx = crypto_skcipher_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(crypto_skcipher_tfm(tfm));
+
+	ctx->fallback = crypto_alloc_skcipher(name, 0, CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		return PTR_ERR(ctx->fallback);
+
+	crypto_skcipher_set_reqsize(tfm, sizeof(struct deu_des_reqctx) +
+				crypto_skcipher_reqsize(ctx->fallback));
+
+	ctx->tmpl = container_of(crypto_skcipher_alg(tfm),
+				struct deu_alg_template, alg.skcipher);
+	ctx->enginectx.op.do_one_request = deu_skcipher_do_one;
+	ctx->enginectx.op.prepare_request = NULL;
+	ctx->enginectx.op.unprepare_request = NULL;
+
+	return 0;
+}
+
+static void deu_skcipher_exit_tfm(struct crypto_skcipher *tfm)
+{
+	struct deu_des_ctx *ctx = crypto_skcipher_ctx(tfm);
+
+	crypto_free_skcipher(ctx->fallback);
+}
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+static int deu_aead_authenc_setkey(struct crypto_aead *tfm, const u8 *key,
+			unsigned int len)
+{
+	struct deu_des_ctx *ctx = crypto_aead_ctx(tfm);
+	struct crypto_authenc_keys keys;
+	int err;
+
+	err = crypto_authenc_extractkeys(&keys, key, len);
+	if (err)
+		goto out;
+
+	err = -EINVAL;
+	if (keys.enckeylen != DES3_EDE_KEY_SIZE)
+		goto out;
+
+	err = verify_aead_des3_key(tfm, keys.enckey, keys.enckeylen);
+	if (err)
+		goto out;
+
+	ctx->keylen = keys.enckeylen / 8 + 1;
+	memcpy(&ctx->key, keys.enckey, keys.enckeylen);
+	ctx->key_gen = deu_next_key_gen();
+
+	err = deu_hmac_setkey(&ctx->hmac, HASH_ALGM_SHA1, keys.authkey,
+				keys.authkeylen);
+	if (err)
+		goto out;
+
+	crypto_aead_clear_flags(ctx->aead_fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_aead_set_flags(ctx->aead_fallback, crypto_aead_get_flags(tfm) &
+						CRYPTO_TFM_REQ_MASK);
+	err = crypto_aead_setkey(ctx->aead_fallback, key, len);
+
+out:
+	memzero_explicit(&keys, sizeof(keys));
+
+	return err;
+}
+
+static int deu_aead_authenc_setauthsize(struct crypto_aead *tfm,
+			unsigned int authsize)
+{
+	struct deu_des_ctx *ctx = crypto_aead_ctx(tfm);
+
+	return crypto_aead_setauthsize(ctx->aead_fallback, authsize);
+}
+
+static int deu_aead_fallback(struct aead_request *req, bool enc)
+{
+	struct deu_des_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct deu_des_aead_reqctx *rctx = aead_request_ctx(req);
+	struct aead_request *subreq = &rctx->fallback_req;
+
+	aead_request_set_tfm(subreq, ctx->aead_fallback);
+	aead_request_set_callback(subreq, req->base.flags,
+				req->base.complete, req->base.data);
+	aead_request_set_crypt(subreq, req->src, req->dst,
+				req->cryptlen, req->iv);
+	aead_request_set_ad(subreq, req->assoclen);
+
+	return enc ? crypto_aead_encrypt(subreq) :
+			crypto_aead_decrypt(subreq);
+}
+
+static int deu_aead_do_one(struct crypto_engine *engine, void *areq)
+{
+	struct aead_request *req = container_of(areq, struct aead_request,
+						base);
+	struct deu_des_aead_reqctx *rctx = aead_request_ctx(req);
 	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
-			struct deu_alg_template, alg.skcipher.base);
+				struct deu_alg_template, alg.aead.base);
+	struct deu_unit *unit = engine->priv_data;
+	int err;
+
+	deu_batch_flush(unit);
+
+	err = deu_aead_authenc_crypt(unit, req, rctx->enc);
+
+	deu_put_unit(unit);
+	deu_stat_done(tmpl, rctx->queued, req->cryptlen, rctx->enc, err);
+	crypto_finalize_aead_request(engine, req, err);
 
-	return deu_skcipher_crypt(req, tmpl->mode, false);
+	return 0;
 }
 
+static int deu_aead_queue(struct aead_request *req, bool enc)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct deu_des_aead_reqctx *rctx = aead_request_ctx(req);
+	struct deu_alg_template *tmpl = container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.aead.base);
+	struct deu_unit *unit;
+	int err;
+
+	if (!enc && req->cryptlen < crypto_aead_authsize(tfm))
+		return -EINVAL;
+
+	/* the unit only does whole CBC blocks, the fallback decides the rest */
+	if ((req->cryptlen - (enc ? 0 : crypto_aead_authsize(tfm))) %
+			DES_BLOCK_SIZE)
+		return deu_aead_fallback(req, enc);
+
+	unit = deu_claim_engine(DEU_UNIT_DES, tmpl, req->cryptlen, enc);
+	if (!unit)
+		return deu_aead_fallback(req, enc);
+
+	rctx->enc = enc;
+	rctx->queued = ktime_get_ns();
+
+	err = crypto_transfer_aead_request_to_engine(unit->engine,
+						req);
+	if (err == -ENOSPC)
+		deu_put_unit(unit);
+
+	return err;
+}
+
+static int deu_aead_encrypt(struct aead_request *req)
+{
+	return deu_aead_queue(req, true);
+}
+
+static int deu_aead_decrypt(struct aead_request *req)
+{
+	return deu_aead_queue(req, false);
+}
+
+static int deu_aead_init_tfm(struct crypto_aead *tfm)
+{
+	struct deu_des_ctx *ctx = crypto_aead_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(crypto_aead_tfm(tfm));
+
+	ctx->aead_fallback = crypto_alloc_aead(name, 0, CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->aead_fallback))
+		return PTR_ERR(ctx->aead_fallback);
+
+	crypto_aead_set_reqsize(tfm, sizeof(struct deu_des_aead_reqctx) +
+				crypto_aead_reqsize(ctx->aead_fallback));
+
+	ctx->tmpl = container_of(crypto_aead_alg(tfm),
+				struct deu_alg_template, alg.aead);
+	ctx->enginectx.op.do_one_request = deu_aead_do_one;
+	ctx->enginectx.op.prepare_request = NULL;
+	ctx->enginectx.op.unprepare_request = NULL;
+
+	return 0;
+}
+
+static void deu_aead_exit_tfm(struct crypto_aead *tfm)
+{
+	struct deu_des_ctx *ctx = crypto_aead_ctx(tfm);
+
+	crypto_free_aead(ctx->aead_fallback);
+}
+#endif
+
 struct deu_alg_template deu_alg_ecb_des = {
 	.type = DEU_ALG_TYPE_SKCIPHER,
 	.mode = MODE_ECB,
@@ -201,6 +755,8 @@ struct deu_alg_template deu_alg_ecb_des = {
 		.setkey = deu_skcipher_des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES_KEY_SIZE,
 		.max_keysize = DES_KEY_SIZE,
 		.ivsize = 0,
@@ -209,6 +765,8 @@ struct deu_alg_template deu_alg_ecb_des = {
 			.cra_driver_name = "ecb(des-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = DES_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
@@ -225,6 +783,8 @@ struct deu_alg_template deu_alg_cbc_des = {
 		.setkey = deu_skcipher_des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES_KEY_SIZE,
 		.max_keysize = DES_KEY_SIZE,
 		.ivsize = DES_BLOCK_SIZE,
@@ -233,10 +793,12 @@ struct deu_alg_template deu_alg_cbc_des = {
 			.cra_driver_name = "cbc(des-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = DES_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
-			.cra_alignmask = 0x7,
+			.cra_alignmask = 0,
 			.cra_module = THIS_MODULE,
 		},
 	},
@@ -249,6 +811,8 @@ struct deu_alg_template deu_alg_ofb_des = {
 		.setkey = deu_skcipher_des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES_KEY_SIZE,
 		.max_keysize = DES_KEY_SIZE,
 		.chunksize = DES_BLOCK_SIZE,
@@ -259,6 +823,8 @@ struct deu_alg_template deu_alg_ofb_des = {
 			.cra_driver_name = "ofb(des-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
@@ -275,6 +841,8 @@ struct deu_alg_template deu_alg_cfb_des = {
 		.setkey = deu_skcipher_des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES_KEY_SIZE,
 		.max_keysize = DES_KEY_SIZE,
 		.chunksize = DES_BLOCK_SIZE,
@@ -285,6 +853,8 @@ struct deu_alg_template deu_alg_cfb_des = {
 			.cra_driver_name = "cfb(des-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
@@ -301,6 +871,8 @@ struct deu_alg_template deu_alg_ctr_des = {
 		.setkey = deu_skcipher_des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES_KEY_SIZE,
 		.max_keysize = DES_KEY_SIZE,
 		.chunksize = DES_BLOCK_SIZE,
@@ -310,10 +882,12 @@ struct deu_alg_template deu_alg_ctr_des = {
 			.cra_driver_name = "ctr(des-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
-			.cra_alignmask = 1,
+			.cra_alignmask = 0,
 			.cra_module = THIS_MODULE,
 		},
 	},
@@ -326,6 +900,8 @@ struct deu_alg_template deu_alg_ecb_des3_ede = {
 		.setkey = deu_skcipher_3des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES3_EDE_KEY_SIZE,
 		.max_keysize = DES3_EDE_KEY_SIZE,
 		.ivsize = 0,
@@ -334,6 +910,8 @@ struct deu_alg_template deu_alg_ecb_des3_ede = {
 			.cra_driver_name = "ecb(des3_ede-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = DES3_EDE_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
@@ -350,6 +928,8 @@ struct deu_alg_template deu_alg_cbc_des3_ede = {
 		.setkey = deu_skcipher_3des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES3_EDE_KEY_SIZE,
 		.max_keysize = DES3_EDE_KEY_SIZE,
 		.ivsize = DES3_EDE_BLOCK_SIZE,
@@ -358,6 +938,8 @@ struct deu_alg_template deu_alg_cbc_des3_ede = {
 			.cra_driver_name = "cbc(des3_ede-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = DES3_EDE_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
@@ -374,6 +956,8 @@ struct deu_alg_template deu_alg_ofb_des3_ede = {
 		.setkey = deu_skcipher_3des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES3_EDE_KEY_SIZE,
 		.max_keysize = DES3_EDE_KEY_SIZE,
 		.chunksize = DES3_EDE_BLOCK_SIZE,
@@ -384,6 +968,8 @@ struct deu_alg_template deu_alg_ofb_des3_ede = {
 			.cra_driver_name = "ofb(des3_ede-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
@@ -397,9 +983,11 @@ struct deu_alg_template deu_alg_cfb_des3_ede = {
 	.type = DEU_ALG_TYPE_SKCIPHER,
 	.mode = MODE_CFB,
 	.alg.skcipher = {
-		.setkey = deu_skcipher_des_setkey,
+		.setkey = deu_skcipher_3des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES3_EDE_KEY_SIZE,
 		.max_keysize = DES3_EDE_KEY_SIZE,
 		.chunksize = DES3_EDE_BLOCK_SIZE,
@@ -410,6 +998,8 @@ struct deu_alg_template deu_alg_cfb_des3_ede = {
 			.cra_driver_name = "cfb(des3_ede-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
@@ -426,20 +1016,54 @@ struct deu_alg_template deu_alg_ctr_des3_ede = {
 		.setkey = deu_skcipher_3des_setkey,
 		.encrypt = deu_skcipher_encrypt,
 		.decrypt = deu_skcipher_decrypt,
+		.init = deu_skcipher_init_tfm,
+		.exit = deu_skcipher_exit_tfm,
 		.min_keysize = DES3_EDE_KEY_SIZE,
 		.max_keysize = DES3_EDE_KEY_SIZE,
 		.chunksize = DES3_EDE_BLOCK_SIZE,
 		.ivsize = DES3_EDE_BLOCK_SIZE,
 		.base = {
-			.cra_name = "ctr(des3_ede",
+			.cra_name = "ctr(des3_ede)",
 			.cra_driver_name = "ctr(des3_ede-deu)",
 			.cra_priority = DEU_CRA_PRIORITY,
 			.cra_flags = CRYPTO_ALG_TYPE_SKCIPHER |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
 					CRYPTO_ALG_KERN_DRIVER_ONLY,
 			.cra_blocksize = 1,
 			.cra_ctxsize = sizeof(struct deu_des_ctx),
-			.cra_alignmask = 1,
+			.cra_alignmask = 0,
+			.cra_module = THIS_MODULE,
+		},
+	},
+};
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_HASH)
+struct deu_alg_template deu_alg_authenc_sha1_cbc_des3_ede = {
+	.type = DEU_ALG_TYPE_AEAD,
+	.mode = MODE_CBC,
+	.alg.aead = {
+		.setkey = deu_aead_authenc_setkey,
+		.setauthsize = deu_aead_authenc_setauthsize,
+		.encrypt = deu_aead_encrypt,
+		.decrypt = deu_aead_decrypt,
+		.init = deu_aead_init_tfm,
+		.exit = deu_aead_exit_tfm,
+		.ivsize = DES3_EDE_BLOCK_SIZE,
+		.maxauthsize = SHA1_DIGEST_SIZE,
+		.base = {
+			.cra_name = "authenc(hmac(sha1),cbc(des3_ede))",
+			.cra_driver_name = "authenc(hmac(sha1-deu),cbc(des3_ede-deu))",
+			.cra_priority = DEU_CRA_PRIORITY,
+			.cra_flags = CRYPTO_ALG_TYPE_AEAD |
+					CRYPTO_ALG_ASYNC |
+					CRYPTO_ALG_NEED_FALLBACK |
+					CRYPTO_ALG_KERN_DRIVER_ONLY,
+			.cra_blocksize = DES3_EDE_BLOCK_SIZE,
+			.cra_ctxsize = sizeof(struct deu_des_ctx),
+			.cra_alignmask = 0,
 			.cra_module = THIS_MODULE,
 		},
 	},
 };
+#endif
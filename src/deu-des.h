@@ -16,8 +16,14 @@
 #ifndef _DEU_DES_H_
 #define _DEU_DES_H_
 
+#include <crypto/aead.h>
+#include <crypto/engine.h>
 #include <crypto/internal/des.h>
 
+#include "deu-hash.h"
+
+#define DEU_DES_BASE	0x10
+
 #define MODE_ECB	0
 #define MODE_CBC	1
 #define MODE_OFB	2
@@ -63,11 +69,29 @@ struct des_t {
 };
 
 struct deu_des_ctx {
+	struct crypto_engine_ctx enginectx;
+	struct deu_alg_template	*tmpl;
 	int	keylen;
+	u32	key_gen;
         u32	key[DES3_EDE_KEY_SIZE / 4];
 	u32	iv[DES_BLOCK_SIZE / 4];
+	struct crypto_skcipher	*fallback;
+	struct crypto_aead	*aead_fallback;
+	struct deu_hmac_key	hmac;
+};
+
+struct deu_des_reqctx {
+	bool	enc;
+	u64	queued;		/* ktime_get_ns() */
+	struct skcipher_request	fallback_req;	// keep at the end
+};
+
+struct deu_des_aead_reqctx {
+	bool	enc;
+	u64	queued;		/* ktime_get_ns() */
+	struct aead_request	fallback_req;	// keep at the end
 };
 
-void des_init_hw(__iomem void *base);
+void des_init_hw(struct deu_unit *unit, __iomem void *base);
 
 #endif /* _DEU_DES_H_ */
@@ -0,0 +1,409 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * DMA data path for the Data Encryption Unit
+ *
+ * Requests of at least dma_threshold bytes whose scatterlists satisfy the
+ * DMA alignment are streamed through the DEU by the central DMA, the TX
+ * channel feeding the input and the RX channel draining the output
+ * registers. Everything else keeps using PIO.
+ *
+ * Copyright (C) 2021 Richard van Schagen <vschagen@icloud.com>
+ */
+
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
+#include <linux/iopoll.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+
+#if IS_ENABLED(CONFIG_LANTIQ)
+#include <xway_dma.h>
+#endif
+
+#include "deu-core.h"
+#include "deu-dma.h"
+#include "deu-model.h"
+
+static unsigned int dma_threshold = 1024;
+module_param(dma_threshold, uint, 0644);
+MODULE_PARM_DESC(dma_threshold, "Requests from this size on use DMA (0 = PIO only)");
+
+static unsigned int irq_threshold = 2048;
+module_param(irq_threshold, uint, 0644);
+MODULE_PARM_DESC(irq_threshold, "DMA transfers from this size on sleep on the RX channel interrupt");
+
+/* DMA side of one DEU instance */
+struct deu_dma {
+	/* one DMA controller for the AES and DES workers */
+	struct mutex		lock;
+	bool			ready;
+#if IS_ENABLED(CONFIG_LANTIQ)
+	void __iomem		*membase;
+	struct ltq_dma_channel	tx;
+	struct ltq_dma_channel	rx;
+	int			irq;		/* RX channel, or none */
+	struct completion	done;
+#endif
+};
+
+#if IS_ENABLED(CONFIG_LANTIQ)
+
+/*
+ * Hand the entries covering nbytes to the channel. A slot the DMA still
+ * owns is never written over: nothing is posted and -EBUSY returned.
+ */
+static struct ltq_dma_desc *deu_dma_post(struct ltq_dma_channel *ch,
+			struct scatterlist *sgl, int nents,
+			unsigned int nbytes, bool rx)
+{
+	struct ltq_dma_desc *desc = NULL;
+	struct scatterlist *sg;
+	unsigned int left = nbytes;
+	int i;
+
+	for_each_sg(sgl, sg, nents, i) {
+		desc = &ch->desc_base[(ch->desc + i) % LTQ_DESC_NUM];
+		if (READ_ONCE(desc->ctl) & LTQ_DMA_OWN)
+			return ERR_PTR(-EBUSY);
+
+		left -= min(sg_dma_len(sg), left);
+		if (!left)
+			break;
+	}
+
+	for_each_sg(sgl, sg, nents, i) {
+		unsigned int len = min(sg_dma_len(sg), nbytes);
+		u32 ctl = LTQ_DMA_OWN | (len & LTQ_DMA_SIZE_MASK);
+
+		nbytes -= len;
+		/* the RX side gets SOP/EOP from the hardware */
+		if (!rx && !i)
+			ctl |= LTQ_DMA_SOP;
+		if (!rx && !nbytes)
+			ctl |= LTQ_DMA_EOP;
+
+		desc = &ch->desc_base[ch->desc];
+		desc->addr = sg_dma_address(sg);
+		wmb();
+		desc->ctl = ctl;
+		ch->desc = (ch->desc + 1) % LTQ_DESC_NUM;
+
+		if (!nbytes)
+			break;
+	}
+
+	return desc;
+}
+
+static irqreturn_t deu_dma_irq_handler(int irq, void *dev_id)
+{
+	struct deu_dma *dma = dev_id;
+
+	ltq_dma_disable_irq(&dma->rx);
+	ltq_dma_ack_irq(&dma->rx);
+	complete(&dma->done);
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * Wait for the DMA to give back the last RX descriptor. The RX interrupt
+ * fires per descriptor, so it is armed again until the last one is done;
+ * it is enabled before OWN is checked, a descriptor completing in between
+ * still raises it.
+ */
+static int deu_dma_wait(struct deu_dma *dma, struct ltq_dma_desc *last,
+			unsigned int nbytes)
+{
+	unsigned int timeout_us = DEU_DMA_TIMEOUT_US +
+			DIV_ROUND_UP(nbytes, SZ_1K) * DEU_DMA_KB_US;
+	unsigned long end = jiffies + usecs_to_jiffies(timeout_us) + 1;
+	u32 ctl;
+
+	if (dma->irq <= 0 || nbytes < irq_threshold)
+		return read_poll_timeout(READ_ONCE, ctl, !(ctl & LTQ_DMA_OWN),
+				DEU_DMA_POLL_US, timeout_us, false,
+				last->ctl);
+
+	for (;;) {
+		reinit_completion(&dma->done);
+		ltq_dma_enable_irq(&dma->rx);
+		if (!(READ_ONCE(last->ctl) & LTQ_DMA_OWN))
+			break;
+
+		if (time_after(jiffies, end) ||
+		    !wait_for_completion_timeout(&dma->done, end - jiffies)) {
+			if (!(READ_ONCE(last->ctl) & LTQ_DMA_OWN))
+				break;
+			ltq_dma_disable_irq(&dma->rx);
+			return -ETIMEDOUT;
+		}
+	}
+	ltq_dma_disable_irq(&dma->rx);
+
+	return 0;
+}
+
+static int deu_dma_open(struct deu_dma *dma)
+{
+	ltq_dma_alloc_tx(&dma->tx);
+	if (!dma->tx.desc_base)
+		return -ENOMEM;
+
+	ltq_dma_alloc_rx(&dma->rx);
+	if (!dma->rx.desc_base) {
+		ltq_dma_free(&dma->tx);
+		dma->tx.desc_base = NULL;
+		return -ENOMEM;
+	}
+
+	ltq_dma_open(&dma->tx);
+	ltq_dma_open(&dma->rx);
+	ltq_dma_disable_irq(&dma->tx);
+	ltq_dma_disable_irq(&dma->rx);
+
+	return 0;
+}
+
+static void deu_dma_close(struct deu_dma *dma)
+{
+	if (!dma->tx.desc_base)
+		return;
+
+	ltq_dma_free(&dma->rx);
+	ltq_dma_free(&dma->tx);
+	dma->rx.desc_base = NULL;
+	dma->tx.desc_base = NULL;
+}
+
+/*
+ * An unfinished transfer leaves descriptors the DMA owns pointing at the
+ * caller's pages. Stop both channels and start again on fresh rings
+ * before those pages are unmapped; if that fails DMA stays off.
+ */
+static void deu_dma_reset(struct deu_dev *deu)
+{
+	struct deu_dma *dma = deu->dma;
+
+	deu_dma_close(dma);
+	if (deu_dma_open(dma)) {
+		dev_err(deu->dev, "DMA channels lost, using PIO only\n");
+		dma->ready = false;
+	}
+}
+
+static int deu_dma_xfer_hw(struct deu_dev *deu, int algo,
+			struct scatterlist *src, struct scatterlist *dst,
+			unsigned int nbytes)
+{
+	struct deu_dma *dma = deu->dma;
+	union deu_dma_control *dmac = (union deu_dma_control *)dma->membase;
+	struct device *dev = deu->dev;
+	int nsrc = sg_nents_for_len(src, nbytes);
+	int ndst = sg_nents_for_len(dst, nbytes);
+	struct ltq_dma_desc *last, *desc;
+	int msrc, mdst;
+	int err;
+
+	if (src == dst) {
+		msrc = dma_map_sg(dev, src, nsrc, DMA_BIDIRECTIONAL);
+		mdst = msrc;
+	} else {
+		msrc = dma_map_sg(dev, src, nsrc, DMA_TO_DEVICE);
+		mdst = dma_map_sg(dev, dst, ndst, DMA_FROM_DEVICE);
+	}
+	if (!msrc || !mdst) {
+		err = -ENOMEM;
+		goto unmap;
+	}
+
+	dmac->bits.ALGO = algo;
+	dmac->bits.BS = 0;
+	dmac->bits.EN = 1;
+	wmb();
+
+	last = deu_dma_post(&dma->rx, dst, mdst, nbytes, true);
+	if (IS_ERR(last)) {
+		err = PTR_ERR(last);
+		goto stop;
+	}
+
+	desc = deu_dma_post(&dma->tx, src, msrc, nbytes, false);
+	if (IS_ERR(desc))
+		err = PTR_ERR(desc);
+	else
+		err = deu_dma_wait(dma, last, nbytes);
+
+stop:
+	dmac->bits.EN = 0;
+	wmb();
+
+	if (err) {
+		dev_err_ratelimited(dev, "DMA transfer failed (%d)\n", err);
+		deu_dma_reset(deu);
+	}
+
+unmap:
+	if (src == dst) {
+		if (msrc)
+			dma_unmap_sg(dev, src, nsrc, DMA_BIDIRECTIONAL);
+	} else {
+		if (msrc)
+			dma_unmap_sg(dev, src, nsrc, DMA_TO_DEVICE);
+		if (mdst)
+			dma_unmap_sg(dev, dst, ndst, DMA_FROM_DEVICE);
+	}
+
+	return err;
+}
+
+static int deu_dma_init_hw(struct deu_dev *deu)
+{
+	struct platform_device *pdev = to_platform_device(deu->dev);
+	struct deu_dma *dma = deu->dma;
+	struct device *dev = deu->dev;
+	u32 ch[2];
+	int err;
+
+	BUILD_BUG_ON(DEU_DMA_DESC > LTQ_DESC_NUM);
+
+	/* no channels assigned in the devicetree: PIO only */
+	if (of_property_read_u32_array(dev->of_node, "lantiq,dma-channels",
+					ch, ARRAY_SIZE(ch)))
+		return 0;
+
+	dma->membase = deu->base + DEU_DMA_BASE;
+	init_completion(&dma->done);
+
+	ltq_dma_init_port(DMA_PORT_DEU);
+
+	dma->tx.nr = ch[0];
+	dma->tx.dev = dev;
+	dma->rx.nr = ch[1];
+	dma->rx.dev = dev;
+	err = deu_dma_open(dma);
+	if (err)
+		return err;
+
+	/* without the RX channel interrupt every transfer polls */
+	dma->irq = platform_get_irq_byname_optional(pdev, "dma-rx");
+	if (dma->irq > 0 && devm_request_irq(dev, dma->irq,
+				deu_dma_irq_handler, 0, "deu-dma-rx", dma)) {
+		dev_warn(dev, "DMA irq %d unavailable, polling only\n",
+			dma->irq);
+		dma->irq = -ENXIO;
+	}
+
+	dma->ready = true;
+
+	return 0;
+}
+
+static void deu_dma_exit_hw(struct deu_dev *deu)
+{
+	deu_dma_close(deu->dma);
+}
+#else
+static int deu_dma_xfer_hw(struct deu_dev *deu, int algo,
+			struct scatterlist *src, struct scatterlist *dst,
+			unsigned int nbytes)
+{
+	return -ENODEV;
+}
+
+static int deu_dma_init_hw(struct deu_dev *deu)
+{
+	return 0;
+}
+
+static void deu_dma_exit_hw(struct deu_dev *deu)
+{
+}
+#endif
+
+static bool deu_dma_sg_ok(struct scatterlist *sg, unsigned int nbytes)
+{
+	int nents = 0;
+
+	for (; sg && nbytes; sg = sg_next(sg)) {
+		unsigned int len = min(sg->length, nbytes);
+
+		if (!IS_ALIGNED(sg->offset, DEU_DMA_ALIGN) ||
+				len > DEU_DMA_MAX_LEN ||
+				++nents > DEU_DMA_DESC)
+			return false;
+
+		/* only the final entry may end off the DMA alignment */
+		nbytes -= len;
+		if (nbytes && !IS_ALIGNED(len, DEU_DMA_ALIGN))
+			return false;
+	}
+
+	return !nbytes;
+}
+
+bool deu_dma_capable(struct deu_unit *unit, struct scatterlist *src,
+			struct scatterlist *dst, unsigned int nbytes,
+			unsigned int bsize)
+{
+	if (!unit->deu->dma->ready || !dma_threshold || nbytes < dma_threshold)
+		return false;
+
+	if (nbytes % bsize)
+		return false;
+
+	return deu_dma_sg_ok(src, nbytes) && deu_dma_sg_ok(dst, nbytes);
+}
+
+/*
+ * Stream nbytes from src to dst through the unit selected by algo. The
+ * caller has programmed key, mode and IV and owns the unit until this
+ * returns; may sleep.
+ */
+int deu_dma_transfer(struct deu_unit *unit, int algo,
+			struct scatterlist *src, struct scatterlist *dst,
+			unsigned int nbytes)
+{
+	struct deu_dev *deu = unit->deu;
+	int err;
+
+	mutex_lock(&deu->dma->lock);
+
+	if (deu->model)
+		err = deu_model_dma(deu, algo, src, dst, nbytes);
+	else
+		err = deu_dma_xfer_hw(deu, algo, src, dst, nbytes);
+
+	mutex_unlock(&deu->dma->lock);
+
+	return err;
+}
+
+int deu_dma_init(struct deu_dev *deu)
+{
+	deu->dma = devm_kzalloc(deu->dev, sizeof(*deu->dma), GFP_KERNEL);
+	if (!deu->dma)
+		return -ENOMEM;
+
+	mutex_init(&deu->dma->lock);
+
+	if (deu->model) {
+		deu->dma->ready = true;
+		return 0;
+	}
+
+	return deu_dma_init_hw(deu);
+}
+
+void deu_dma_exit(struct deu_dev *deu)
+{
+	if (!deu->model)
+		deu_dma_exit_hw(deu);
+
+	deu->dma->ready = false;
+}
@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-2.0
+ *
+ * Copyright (C) 2021
+ *
+ * Richard van Schagen <vschagen@icloud.com>
+ */
+#ifndef _DEU_DMA_H_
+#define _DEU_DMA_H_
+
+#include <linux/device.h>
+#include <linux/scatterlist.h>
+
+#define DEU_DMA_BASE		0xec
+#define DEU_DMA_ALIGN		16
+#define DEU_DMA_DESC		32
+#define DEU_DMA_MAX_LEN		0xfff0
+#define DEU_DMA_POLL_US		10
+#define DEU_DMA_TIMEOUT_US	1000	/* plus DEU_DMA_KB_US per KB */
+#define DEU_DMA_KB_US		200
+
+#define DEU_DMA_ALGO_DES	0
+#define DEU_DMA_ALGO_AES	1
+
+union deu_dma_control {
+	u32	word;
+	struct {
+		u32 Res1:22;
+		u32 BS:2;
+		u32 BSY:1;
+		u32 Res2:1;
+		u32 ALGO:2;
+		u32 RXCLS:2;
+		u32 Res3:1;
+		u32 EN:1;
+	} bits;
+} __packed;
+
+struct deu_dev;
+struct deu_unit;
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_DMA)
+int deu_dma_init(struct deu_dev *deu);
+void deu_dma_exit(struct deu_dev *deu);
+bool deu_dma_capable(struct deu_unit *unit, struct scatterlist *src,
+			struct scatterlist *dst, unsigned int nbytes,
+			unsigned int bsize);
+int deu_dma_transfer(struct deu_unit *unit, int algo,
+			struct scatterlist *src, struct scatterlist *dst,
+			unsigned int nbytes);
+#else
+static inline int deu_dma_init(struct deu_dev *deu)
+{
+	return 0;
+}
+
+static inline void deu_dma_exit(struct deu_dev *deu)
+{
+}
+
+static inline bool deu_dma_capable(struct deu_unit *unit,
+			struct scatterlist *src, struct scatterlist *dst,
+			unsigned int nbytes, unsigned int bsize)
+{
+	return false;
+}
+
+static inline int deu_dma_transfer(struct deu_unit *unit, int algo,
+			struct scatterlist *src, struct scatterlist *dst,
+			unsigned int nbytes)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* _DEU_DMA_H_ */
@@ -0,0 +1,703 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Hash unit of the Data Encryption Unit
+ *
+ * The unit computes SHA-1 or MD5 compression over 64-byte blocks written
+ * word by word to MR, starting from the digest held in D1R-D5R. Loading
+ * those registers from memory lets any number of streams share the unit;
+ * padding is done by the driver.
+ *
+ * Copyright (C) 2021 Richard van Schagen <vschagen@icloud.com>
+ */
+
+#include <linux/sched/clock.h>
+#include <linux/timekeeping.h>
+#include <asm/unaligned.h>
+#include <crypto/internal/hash.h>
+#include <crypto/scatterwalk.h>
+
+#include "deu-core.h"
+#include "deu-hash.h"
+#include "deu-model.h"
+
+static const u32 sha1_iv[DEU_HASH_WORDS] = {
+	SHA1_H0, SHA1_H1, SHA1_H2, SHA1_H3, SHA1_H4,
+};
+
+static const u32 md5_iv[DEU_HASH_WORDS] = {
+	MD5_H0, MD5_H1, MD5_H2, MD5_H3,
+};
+
+/* The shadowed CTRL, see deu_ctrl_flush() */
+#define hash_ctrl(unit)	((union hash_control *)&(unit)->ctrl)
+
+static const union hash_control hash_ctrl_status = {
+	.bits = { .DGRY = 1, .BSY = 1 },
+};
+
+static const union hash_control hash_ctrl_trigger = {
+	.bits = { .INIT = 1 },
+};
+
+static inline void hash_ctrl_flush(struct deu_unit *unit)
+{
+	deu_ctrl_flush(unit, hash_ctrl_trigger.word);
+}
+
+void hash_init_hw(struct deu_unit *unit, __iomem void *base)
+{
+	unit->base = base + DEU_HASH_BASE;
+
+	if (base) {
+		union hash_control *ctrl = hash_ctrl(unit);
+
+		deu_ctrl_init(unit, hash_ctrl_status.word);
+		ctrl->bits.SM = 1;
+		ctrl->bits.ENDI = 0;
+		hash_ctrl_flush(unit);
+		wmb();
+		ctrl->bits.INIT = 1;
+		hash_ctrl_flush(unit);
+		wmb();
+	}
+}
+
+unsigned int deu_hash_digestsize(int algm)
+{
+	return algm == HASH_ALGM_MD5 ? MD5_DIGEST_SIZE : SHA1_DIGEST_SIZE;
+}
+
+static inline u32 hash_word(int algm, const u8 *p)
+{
+	if (algm == HASH_ALGM_MD5)
+		return get_unaligned_le32(p);
+
+	return get_unaligned_be32(p);
+}
+
+void deu_hash_begin_locked(struct deu_unit *unit, struct deu_hash_stream *hs)
+{
+	struct hash_t *hash = (struct hash_t *)unit->base;
+
+	hash_ctrl(unit)->bits.ALGM = hs->algm;
+	hash_ctrl(unit)->bits.INIT = 1;
+	hash_ctrl_flush(unit);
+
+	hash->D1R = hs->state[0];
+	hash->D2R = hs->state[1];
+	hash->D3R = hs->state[2];
+	hash->D4R = hs->state[3];
+	if (hs->algm == HASH_ALGM_SHA1)
+		hash->D5R = hs->state[4];
+}
+
+/* Write one block to MR once the previous one is done */
+static int hash_push_block(struct deu_unit *unit, struct deu_hash_stream *hs,
+			const u8 *data)
+{
+	struct hash_t *hash = (struct hash_t *)unit->base;
+	u32 words[DEU_HASH_BLOCK_SIZE / 4];
+	int i, err;
+
+	/* byte order the block while the unit may still be busy */
+	for (i = 0; i < DEU_HASH_BLOCK_SIZE / 4; i++)
+		words[i] = hash_word(hs->algm, data + 4 * i);
+
+	err = deu_wait_ready(unit);
+	if (err)
+		return err;
+
+	for (i = 0; i < DEU_HASH_BLOCK_SIZE / 4; i++)
+		hash->MR = words[i];
+
+	/* the model has no FIFO behind MR, hand it the block */
+	if (unit->deu->model)
+		deu_model_hash_data(unit, words);
+
+	return 0;
+}
+
+/*
+ * Add len bytes to the stream. Whole blocks go to the unit, which keeps
+ * working on the last one when this returns.
+ */
+int deu_hash_feed_locked(struct deu_unit *unit, struct deu_hash_stream *hs,
+			const u8 *data, unsigned int len)
+{
+	unsigned int n;
+	int err;
+
+	hs->count += len;
+
+	if (hs->buflen) {
+		n = min(len, DEU_HASH_BLOCK_SIZE - hs->buflen);
+		memcpy(hs->buf + hs->buflen, data, n);
+		hs->buflen += n;
+		data += n;
+		len -= n;
+
+		if (hs->buflen < DEU_HASH_BLOCK_SIZE)
+			return 0;
+
+		err = hash_push_block(unit, hs, hs->buf);
+		if (err)
+			return err;
+		hs->buflen = 0;
+	}
+
+	while (len >= DEU_HASH_BLOCK_SIZE) {
+		err = hash_push_block(unit, hs, data);
+		if (err)
+			return err;
+		data += DEU_HASH_BLOCK_SIZE;
+		len -= DEU_HASH_BLOCK_SIZE;
+	}
+
+	memcpy(hs->buf, data, len);
+	hs->buflen = len;
+
+	return 0;
+}
+
+/* Account a hold of the hash unit lock taken along with another unit's */
+void deu_hash_account_locked(struct deu_unit *unit,
+			struct deu_alg_template *tmpl, u64 wait, u64 start)
+{
+	deu_account_hold(unit, tmpl, wait, start);
+}
+
+int deu_hash_end_locked(struct deu_unit *unit, struct deu_hash_stream *hs)
+{
+	struct hash_t *hash = (struct hash_t *)unit->base;
+	int err;
+
+	err = deu_wait_ready(unit);
+	if (err)
+		return err;
+
+	hs->state[0] = hash->D1R;
+	hs->state[1] = hash->D2R;
+	hs->state[2] = hash->D3R;
+	hs->state[3] = hash->D4R;
+	if (hs->algm == HASH_ALGM_SHA1)
+		hs->state[4] = hash->D5R;
+
+	return 0;
+}
+
+/* NULL state starts from the algorithm's initial digest */
+void deu_hash_stream_init(struct deu_hash_stream *hs, int algm,
+			const u32 *state, u64 count)
+{
+	if (!state)
+		state = algm == HASH_ALGM_MD5 ? md5_iv : sha1_iv;
+
+	hs->algm = algm;
+	hs->tmpl = NULL;
+	memcpy(hs->state, state, sizeof(hs->state));
+	hs->count = count;
+	hs->buflen = 0;
+}
+
+int deu_hash_stream_update(struct deu_unit *unit, struct deu_hash_stream *hs,
+			const u8 *data, unsigned int len)
+{
+	unsigned int chunk, max = deu_chunk_blocks() * DEU_HASH_BLOCK_SIZE;
+	unsigned long flag;
+	int err = 0;
+	u64 wait, start;
+
+	/* nothing reaches the unit until a block is complete */
+	if (hs->buflen + len < DEU_HASH_BLOCK_SIZE) {
+		memcpy(hs->buf + hs->buflen, data, len);
+		hs->buflen += len;
+		hs->count += len;
+		return 0;
+	}
+
+	while (len && !err) {
+		chunk = min(len, max);
+
+		/* only called from engine workers and setkey */
+		wait = local_clock();
+		deu_unit_lock(unit, &flag, true);
+		start = deu_lock_taken(unit, hs->tmpl, wait);
+
+		deu_hash_begin_locked(unit, hs);
+		err = deu_hash_feed_locked(unit, hs, data, chunk);
+		if (!err)
+			err = deu_hash_end_locked(unit, hs);
+
+		deu_account_hold(unit, hs->tmpl, wait, start);
+		deu_unit_unlock(unit, &flag);
+
+		data += chunk;
+		len -= chunk;
+	}
+
+	return err;
+}
+
+/*
+ * Hash straight from the mapped scatterlist pages, no bounce copy. Not
+ * an atomic mapping, so a slow block can sleep, see deu_wait_ready().
+ */
+int deu_hash_stream_update_sg(struct deu_unit *unit, struct deu_hash_stream *hs,
+			struct scatterlist *sg, unsigned int len)
+{
+	struct sg_mapping_iter miter;
+	unsigned int n;
+	int nents;
+	int err = 0;
+
+	if (!len)
+		return 0;
+
+	nents = sg_nents_for_len(sg, len);
+	if (nents < 0)
+		return nents;
+
+	sg_miter_start(&miter, sg, nents, SG_MITER_FROM_SG);
+
+	while (len && !err && sg_miter_next(&miter)) {
+		n = min_t(unsigned int, len, miter.length);
+		deu_stat_walk(unit, hs->tmpl, n, DEU_OP_HASH);
+		err = deu_hash_stream_update(unit, hs, miter.addr, n);
+		len -= n;
+	}
+
+	sg_miter_stop(&miter);
+
+	return err;
+}
+
+/* Pad the stream, run the last block(s) and store the digest */
+int deu_hash_stream_final(struct deu_unit *unit, struct deu_hash_stream *hs,
+			u8 *out)
+{
+	u8 pad[2 * DEU_HASH_BLOCK_SIZE] = { 0x80 };
+	unsigned int padlen, i;
+	u64 bits = hs->count << 3;
+	int err;
+
+	padlen = (hs->buflen < 56 ? 56 : 120) - hs->buflen;
+	if (hs->algm == HASH_ALGM_MD5)
+		put_unaligned_le64(bits, pad + padlen);
+	else
+		put_unaligned_be64(bits, pad + padlen);
+
+	err = deu_hash_stream_update(unit, hs, pad, padlen + 8);
+	if (err)
+		return err;
+
+	for (i = 0; i < deu_hash_digestsize(hs->algm) / 4; i++) {
+		if (hs->algm == HASH_ALGM_MD5)
+			put_unaligned_le32(hs->state[i], out + 4 * i);
+		else
+			put_unaligned_be32(hs->state[i], out + 4 * i);
+	}
+
+	return 0;
+}
+
+/*
+ * Precompute the states after the ipad and opad blocks, so a message
+ * only costs its own blocks plus one outer block.
+ */
+int deu_hmac_setkey(struct deu_hmac_key *hk, int algm, const u8 *key,
+			unsigned int keylen)
+{
+	struct deu_hash_stream hs;
+	u8 pad[DEU_HASH_BLOCK_SIZE] = {};
+	struct deu_unit *unit;
+	int i, err;
+
+	unit = deu_get_unit(DEU_UNIT_HASH);
+	if (!unit)
+		return -ENODEV;
+
+	if (keylen > DEU_HASH_BLOCK_SIZE) {
+		deu_hash_stream_init(&hs, algm, NULL, 0);
+		err = deu_hash_stream_update(unit, &hs, key, keylen);
+		if (!err)
+			err = deu_hash_stream_final(unit, &hs, pad);
+		if (err)
+			goto out;
+	} else {
+		memcpy(pad, key, keylen);
+	}
+
+	for (i = 0; i < DEU_HASH_BLOCK_SIZE; i++)
+		pad[i] ^= 0x36;
+
+	deu_hash_stream_init(&hs, algm, NULL, 0);
+	err = deu_hash_stream_update(unit, &hs, pad, DEU_HASH_BLOCK_SIZE);
+	if (err)
+		goto out;
+	memcpy(hk->istate, hs.state, sizeof(hk->istate));
+
+	for (i = 0; i < DEU_HASH_BLOCK_SIZE; i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+
+	deu_hash_stream_init(&hs, algm, NULL, 0);
+	err = deu_hash_stream_update(unit, &hs, pad, DEU_HASH_BLOCK_SIZE);
+	if (err)
+		goto out;
+	memcpy(hk->ostate, hs.state, sizeof(hk->ostate));
+
+out:
+	memzero_explicit(pad, sizeof(pad));
+	memzero_explicit(&hs, sizeof(hs));
+	deu_put_unit(unit);
+
+	return err;
+}
+
+/* Finish an HMAC whose inner stream started from hk->istate */
+int deu_hmac_final(struct deu_unit *unit, struct deu_hash_stream *hs,
+			const struct deu_hmac_key *hk, u8 *out)
+{
+	struct deu_alg_template *tmpl = hs->tmpl;
+	u8 digest[SHA1_DIGEST_SIZE];
+	int algm = hs->algm;
+	int err;
+
+	err = deu_hash_stream_final(unit, hs, digest);
+	if (err)
+		return err;
+
+	deu_hash_stream_init(hs, algm, hk->ostate, DEU_HASH_BLOCK_SIZE);
+	hs->tmpl = tmpl;
+	err = deu_hash_stream_update(unit, hs, digest,
+				deu_hash_digestsize(algm));
+	if (!err)
+		err = deu_hash_stream_final(unit, hs, out);
+
+	memzero_explicit(digest, sizeof(digest));
+
+	return err;
+}
+
+/* Crypto API */
+static struct deu_alg_template *deu_ahash_tmpl(struct ahash_request *req)
+{
+	return container_of(req->base.tfm->__crt_alg,
+				struct deu_alg_template, alg.ahash.halg.base);
+}
+
+static int deu_ahash_algm(struct ahash_request *req)
+{
+	return deu_ahash_tmpl(req)->mode;
+}
+
+static int deu_ahash_do_one(struct crypto_engine *engine, void *areq)
+{
+	struct ahash_request *req = ahash_request_cast(areq);
+	struct deu_hash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct deu_hash_reqctx *rctx = ahash_request_ctx(req);
+	struct deu_unit *unit = engine->priv_data;
+	int err = 0;
+
+	deu_batch_flush(unit);
+
+	/* an imported state may come from another tfm */
+	rctx->hs.tmpl = deu_ahash_tmpl(req);
+
+	if (rctx->op & DEU_HASH_OP_UPDATE)
+		err = deu_hash_stream_update_sg(unit, &rctx->hs, req->src,
+					req->nbytes);
+	if (err || !(rctx->op & DEU_HASH_OP_FINAL))
+		goto out;
+
+	if (ctx->hmac)
+		err = deu_hmac_final(unit, &rctx->hs, &ctx->key, req->result);
+	else
+		err = deu_hash_stream_final(unit, &rctx->hs, req->result);
+
+out:
+	deu_put_unit(unit);
+	deu_stat_done(rctx->hs.tmpl, rctx->queued,
+		      rctx->op & DEU_HASH_OP_UPDATE ? req->nbytes : 0,
+		      DEU_OP_HASH, err);
+	crypto_finalize_hash_request(engine, req, err);
+
+	return 0;
+}
+
+static int deu_ahash_queue(struct ahash_request *req, unsigned int op)
+{
+	struct deu_hash_reqctx *rctx = ahash_request_ctx(req);
+	struct deu_unit *unit;
+	int err;
+
+	if (!(op & DEU_HASH_OP_UPDATE) || !req->nbytes) {
+		if (!(op & DEU_HASH_OP_FINAL))
+			return 0;
+		op = DEU_HASH_OP_FINAL;
+	}
+
+	unit = deu_get_unit(DEU_UNIT_HASH);
+	if (!unit)
+		return -ENODEV;
+
+	deu_stat_request(unit, deu_ahash_tmpl(req),
+			 op & DEU_HASH_OP_UPDATE ? req->nbytes : 0,
+			 DEU_OP_HASH);
+
+	/* an update that does not complete a block only fills the buffer */
+	if (op == DEU_HASH_OP_UPDATE &&
+	    rctx->hs.buflen + req->nbytes < DEU_HASH_BLOCK_SIZE) {
+		scatterwalk_map_and_copy(rctx->hs.buf + rctx->hs.buflen,
+					req->src, 0, req->nbytes, 0);
+		rctx->hs.buflen += req->nbytes;
+		rctx->hs.count += req->nbytes;
+		deu_put_unit(unit);
+		return 0;
+	}
+
+	rctx->op = op;
+	rctx->queued = ktime_get_ns();
+
+	err = crypto_transfer_hash_request_to_engine(unit->engine, req);
+	if (err == -ENOSPC)
+		deu_put_unit(unit);
+
+	return err;
+}
+
+static int deu_ahash_init(struct ahash_request *req)
+{
+	struct deu_hash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct deu_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	/* hmac starts after the cached ipad block */
+	if (ctx->hmac)
+		deu_hash_stream_init(&rctx->hs, deu_ahash_algm(req),
+					ctx->key.istate, DEU_HASH_BLOCK_SIZE);
+	else
+		deu_hash_stream_init(&rctx->hs, deu_ahash_algm(req), NULL, 0);
+
+	return 0;
+}
+
+static int deu_ahash_update(struct ahash_request *req)
+{
+	return deu_ahash_queue(req, DEU_HASH_OP_UPDATE);
+}
+
+static int deu_ahash_final(struct ahash_request *req)
+{
+	return deu_ahash_queue(req, DEU_HASH_OP_FINAL);
+}
+
+static int deu_ahash_finup(struct ahash_request *req)
+{
+	return deu_ahash_queue(req, DEU_HASH_OP_UPDATE | DEU_HASH_OP_FINAL);
+}
+
+static int deu_ahash_digest(struct ahash_request *req)
+{
+	return deu_ahash_init(req) ?: deu_ahash_finup(req);
+}
+
+static int deu_ahash_export(struct ahash_request *req, void *out)
+{
+	struct deu_hash_reqctx *rctx = ahash_request_ctx(req);
+	struct deu_hash_export *ex = out;
+
+	ex->algm = rctx->hs.algm;
+	memcpy(ex->state, rctx->hs.state, sizeof(ex->state));
+	ex->count = rctx->hs.count;
+	ex->buflen = rctx->hs.buflen;
+	memcpy(ex->buf, rctx->hs.buf, sizeof(ex->buf));
+
+	return 0;
+}
+
+static int deu_ahash_import(struct ahash_request *req, const void *in)
+{
+	struct deu_hash_reqctx *rctx = ahash_request_ctx(req);
+	const struct deu_hash_export *ex = in;
+
+	if (ex->algm != deu_ahash_algm(req) ||
+	    ex->buflen >= DEU_HASH_BLOCK_SIZE)
+		return -EINVAL;
+
+	rctx->hs.algm = ex->algm;
+	rctx->hs.tmpl = deu_ahash_tmpl(req);
+	memcpy(rctx->hs.state, ex->state, sizeof(ex->state));
+	rctx->hs.count = ex->count;
+	rctx->hs.buflen = ex->buflen;
+	memcpy(rctx->hs.buf, ex->buf, sizeof(ex->buf));
+
+	return 0;
+}
+
+static int deu_ahash_cra_init(struct crypto_tfm *tfm)
+{
+	struct deu_hash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				sizeof(struct deu_hash_reqctx));
+
+	ctx->enginectx.op.do_one_request = deu_ahash_do_one;
+	ctx->enginectx.op.prepare_request = NULL;
+	ctx->enginectx.op.unprepare_request = NULL;
+
+	return 0;
+}
+
+static int deu_hmac_cra_init(struct crypto_tfm *tfm)
+{
+	struct deu_hash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->hmac = true;
+
+	return deu_ahash_cra_init(tfm);
+}
+
+static int deu_ahash_hmac_setkey(struct crypto_ahash *tfm, const u8 *key,
+			unsigned int keylen)
+{
+	struct deu_hash_ctx *ctx = crypto_ahash_ctx(tfm);
+	struct crypto_alg *alg = crypto_ahash_tfm(tfm)->__crt_alg;
+	struct deu_alg_template *tmpl = container_of(alg,
+				struct deu_alg_template, alg.ahash.halg.base);
+
+	return deu_hmac_setkey(&ctx->key, tmpl->mode, key, keylen);
+}
+
+static void deu_hmac_cra_exit(struct crypto_tfm *tfm)
+{
+	struct deu_hash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	memzero_explicit(&ctx->key, sizeof(ctx->key));
+}
+
+struct deu_alg_template deu_alg_sha1 = {
+	.type = DEU_ALG_TYPE_AHASH,
+	.mode = HASH_ALGM_SHA1,
+	.alg.ahash = {
+		.init = deu_ahash_init,
+		.update = deu_ahash_update,
+		.final = deu_ahash_final,
+		.finup = deu_ahash_finup,
+		.digest = deu_ahash_digest,
+		.export = deu_ahash_export,
+		.import = deu_ahash_import,
+		.halg = {
+			.digestsize = SHA1_DIGEST_SIZE,
+			.statesize = sizeof(struct deu_hash_export),
+			.base = {
+				.cra_name = "sha1",
+				.cra_driver_name = "sha1-deu",
+				.cra_priority = DEU_CRA_PRIORITY,
+				.cra_flags = CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_KERN_DRIVER_ONLY,
+				.cra_blocksize = SHA1_BLOCK_SIZE,
+				.cra_ctxsize = sizeof(struct deu_hash_ctx),
+				.cra_alignmask = 0,
+				.cra_init = deu_ahash_cra_init,
+				.cra_module = THIS_MODULE,
+			},
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_md5 = {
+	.type = DEU_ALG_TYPE_AHASH,
+	.mode = HASH_ALGM_MD5,
+	.alg.ahash = {
+		.init = deu_ahash_init,
+		.update = deu_ahash_update,
+		.final = deu_ahash_final,
+		.finup = deu_ahash_finup,
+		.digest = deu_ahash_digest,
+		.export = deu_ahash_export,
+		.import = deu_ahash_import,
+		.halg = {
+			.digestsize = MD5_DIGEST_SIZE,
+			.statesize = sizeof(struct deu_hash_export),
+			.base = {
+				.cra_name = "md5",
+				.cra_driver_name = "md5-deu",
+				.cra_priority = DEU_CRA_PRIORITY,
+				.cra_flags = CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_KERN_DRIVER_ONLY,
+				.cra_blocksize = MD5_HMAC_BLOCK_SIZE,
+				.cra_ctxsize = sizeof(struct deu_hash_ctx),
+				.cra_alignmask = 0,
+				.cra_init = deu_ahash_cra_init,
+				.cra_module = THIS_MODULE,
+			},
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_hmac_sha1 = {
+	.type = DEU_ALG_TYPE_AHASH,
+	.mode = HASH_ALGM_SHA1,
+	.alg.ahash = {
+		.init = deu_ahash_init,
+		.update = deu_ahash_update,
+		.final = deu_ahash_final,
+		.finup = deu_ahash_finup,
+		.digest = deu_ahash_digest,
+		.export = deu_ahash_export,
+		.import = deu_ahash_import,
+		.setkey = deu_ahash_hmac_setkey,
+		.halg = {
+			.digestsize = SHA1_DIGEST_SIZE,
+			.statesize = sizeof(struct deu_hash_export),
+			.base = {
+				.cra_name = "hmac(sha1)",
+				.cra_driver_name = "hmac(sha1-deu)",
+				.cra_priority = DEU_CRA_PRIORITY,
+				.cra_flags = CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_KERN_DRIVER_ONLY,
+				.cra_blocksize = SHA1_BLOCK_SIZE,
+				.cra_ctxsize = sizeof(struct deu_hash_ctx),
+				.cra_alignmask = 0,
+				.cra_init = deu_hmac_cra_init,
+				.cra_exit = deu_hmac_cra_exit,
+				.cra_module = THIS_MODULE,
+			},
+		},
+	},
+};
+
+struct deu_alg_template deu_alg_hmac_md5 = {
+	.type = DEU_ALG_TYPE_AHASH,
+	.mode = HASH_ALGM_MD5,
+	.alg.ahash = {
+		.init = deu_ahash_init,
+		.update = deu_ahash_update,
+		.final = deu_ahash_final,
+		.finup = deu_ahash_finup,
+		.digest = deu_ahash_digest,
+		.export = deu_ahash_export,
+		.import = deu_ahash_import,
+		.setkey = deu_ahash_hmac_setkey,
+		.halg = {
+			.digestsize = MD5_DIGEST_SIZE,
+			.statesize = sizeof(struct deu_hash_export),
+			.base = {
+				.cra_name = "hmac(md5)",
+				.cra_driver_name = "hmac(md5-deu)",
+				.cra_priority = DEU_CRA_PRIORITY,
+				.cra_flags = CRYPTO_ALG_TYPE_AHASH |
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_KERN_DRIVER_ONLY,
+				.cra_blocksize = MD5_HMAC_BLOCK_SIZE,
+				.cra_ctxsize = sizeof(struct deu_hash_ctx),
+				.cra_alignmask = 0,
+				.cra_init = deu_hmac_cra_init,
+				.cra_exit = deu_hmac_cra_exit,
+				.cra_module = THIS_MODULE,
+			},
+		},
+	},
+};
@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: GPL-2.0
+ *
+ * Copyright (C) 2021
+ *
+ * Richard van Schagen <vschagen@icloud.com>
+ */
+#ifndef _DEU_HASH_H_
+#define _DEU_HASH_H_
+
+#include <crypto/engine.h>
+#include <crypto/md5.h>
+#include <crypto/sha.h>
+#include <linux/scatterlist.h>
+#include <linux/spinlock.h>
+
+struct deu_alg_template;
+struct deu_unit;
+
+#define DEU_HASH_BASE		0xb0
+
+#define HASH_ALGM_SHA1		0
+#define HASH_ALGM_MD5		1
+
+#define DEU_HASH_BLOCK_SIZE	SHA1_BLOCK_SIZE
+#define DEU_HASH_WORDS		(SHA1_DIGEST_SIZE / 4)
+
+union hash_control {
+	u32	word;
+	struct {
+		u32 reserved1:5;
+		u32 KHS:1;
+		u32 GO:1;
+		u32 INIT:1;
+		u32 reserved2:6;
+		u32 NDC:1;
+		u32 ENDI:1;
+		u32 reserved3:7;
+		u32 DGRY:1;
+		u32 BSY:1;
+		u32 reserved4:1;
+		u32 IRCL:1;
+		u32 SM:1;
+		u32 KYUE:1;
+		u32 HMEN:1;
+		u32 SSEN:1;
+		u32 ALGM:1;
+	} bits;
+} __packed;
+
+struct hash_t {
+	union hash_control CTRL;
+	u32	MR;	// B4h
+	u32	D1R;	// B8h
+	u32	D2R;	// BCh
+	u32	D3R;	// C0h
+	u32	D4R;	// C4h
+	u32	D5R;	// C8h
+	u32	dummy;	// CCh
+	u32	KIDX;	// D0h
+	u32	KEY;	// D4h
+	u32	DBN;	// D8h
+};
+
+/*
+ * Running hash over a byte stream. The state is kept in the algorithm's
+ * own words (big endian SHA-1, little endian MD5), which is also what
+ * the unit's MR and digest registers take.
+ */
+struct deu_hash_stream {
+	int		algm;
+	struct deu_alg_template *tmpl;	/* counters to charge, or NULL */
+	u32		state[DEU_HASH_WORDS];
+	u64		count;
+	unsigned int	buflen;
+	u8		buf[DEU_HASH_BLOCK_SIZE];
+};
+
+/* deu_hash_stream as exported, without the kernel pointer */
+struct deu_hash_export {
+	u32		algm;
+	u32		state[DEU_HASH_WORDS];
+	u64		count;
+	u32		buflen;
+	u8		buf[DEU_HASH_BLOCK_SIZE];
+} __packed;
+
+/* HMAC states after the ipad and opad blocks */
+struct deu_hmac_key {
+	u32		istate[DEU_HASH_WORDS];
+	u32		ostate[DEU_HASH_WORDS];
+};
+
+#define DEU_HASH_OP_UPDATE	BIT(0)
+#define DEU_HASH_OP_FINAL	BIT(1)
+
+struct deu_hash_ctx {
+	struct crypto_engine_ctx	enginectx;
+	bool			hmac;
+	struct deu_hmac_key	key;
+};
+
+struct deu_hash_reqctx {
+	unsigned int		op;
+	u64			queued;		/* ktime_get_ns() */
+	struct deu_hash_stream	hs;
+};
+
+void hash_init_hw(struct deu_unit *unit, __iomem void *base);
+
+/*
+ * The stream is exported as the ahash state, so it never holds the unit:
+ * every call names the hash unit to run on.
+ */
+unsigned int deu_hash_digestsize(int algm);
+void deu_hash_stream_init(struct deu_hash_stream *hs, int algm,
+			const u32 *state, u64 count);
+int deu_hash_stream_update(struct deu_unit *unit, struct deu_hash_stream *hs,
+			const u8 *data, unsigned int len);
+int deu_hash_stream_update_sg(struct deu_unit *unit,
+			struct deu_hash_stream *hs, struct scatterlist *sg,
+			unsigned int len);
+int deu_hash_stream_final(struct deu_unit *unit, struct deu_hash_stream *hs,
+			u8 *out);
+
+/* For callers driving another unit at the same time, unit->lock held */
+void deu_hash_begin_locked(struct deu_unit *unit, struct deu_hash_stream *hs);
+int deu_hash_feed_locked(struct deu_unit *unit, struct deu_hash_stream *hs,
+			const u8 *data, unsigned int len);
+int deu_hash_end_locked(struct deu_unit *unit, struct deu_hash_stream *hs);
+void deu_hash_account_locked(struct deu_unit *unit,
+			struct deu_alg_template *tmpl, u64 wait, u64 start);
+
+int deu_hmac_setkey(struct deu_hmac_key *hk, int algm, const u8 *key,
+			unsigned int keylen);
+int deu_hmac_final(struct deu_unit *unit, struct deu_hash_stream *hs,
+			const struct deu_hmac_key *hk, u8 *out);
+
+#endif /* _DEU_HASH_H_ */
@@ -0,0 +1,499 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Software register model of the Data Encryption Unit
+ *
+ * Backs the AES, DES and hash register blocks with plain memory so the
+ * driver data paths can run on a machine without a DEU. The driver
+ * programs the model exactly like the hardware; when it waits for BUS to
+ * clear the model performs the operation described by the control, key,
+ * IV and input registers with the kernel's AES/DES/SHA-1 library code.
+ *
+ * Like the hardware, the AES unit only decrypts with the key schedule
+ * prepared by the last PNK request, and KV says whether that still
+ * matches the key registers. BUS stays set for a configurable time per
+ * block, so the driver's polling and timeout paths run as on the board
+ * and optimizations can be compared against a chosen engine latency.
+ * Several instances can be bound to try the multi-engine dispatch.
+ *
+ * Copyright (C) 2021 Richard van Schagen <vschagen@icloud.com>
+ */
+
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/des.h>
+#include <crypto/scatterwalk.h>
+#include <linux/bitops.h>
+#include <linux/delay.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <asm/unaligned.h>
+
+#include "deu-core.h"
+#include "deu-aes.h"
+#include "deu-des.h"
+#include "deu-dma.h"
+#include "deu-hash.h"
+#include "deu-model.h"
+
+static bool model;
+module_param(model, bool, 0444);
+MODULE_PARM_DESC(model, "Bind the software register model instead of the DEU");
+
+static unsigned int model_aes_ns;
+module_param(model_aes_ns, uint, 0644);
+MODULE_PARM_DESC(model_aes_ns, "Model: nanoseconds BUS stays set per AES block");
+
+static unsigned int model_des_ns;
+module_param(model_des_ns, uint, 0644);
+MODULE_PARM_DESC(model_des_ns, "Model: nanoseconds BUS stays set per DES block");
+
+static unsigned int model_hash_ns;
+module_param(model_hash_ns, uint, 0644);
+MODULE_PARM_DESC(model_hash_ns, "Model: nanoseconds BUS stays set per hash block");
+
+static unsigned int model_pnk_ns;
+module_param(model_pnk_ns, uint, 0644);
+MODULE_PARM_DESC(model_pnk_ns, "Model: extra nanoseconds for an AES key pre-processing (PNK)");
+
+static unsigned int model_instances = 1;
+module_param(model_instances, uint, 0444);
+MODULE_PARM_DESC(model_instances, "Model: number of DEU instances to bind (1-" __stringify(DEU_MODEL_MAX) ")");
+
+struct deu_model_aes {
+	u32			key[AES_MAX_KEY_SIZE / 4];
+	int			keylen;
+	struct crypto_aes_ctx	ctx;
+	struct crypto_aes_ctx	dec;	/* schedule from the last PNK */
+	bool			kv;
+	bool			pnk_done;
+};
+
+struct deu_model_des {
+	u32			key[DES3_EDE_KEY_SIZE / 4];
+	int			keylen;
+	struct des_ctx		des;
+	struct des3_ede_ctx	des3;
+};
+
+struct deu_model_hash {
+	u32			data[DEU_HASH_BLOCK_SIZE / 4];
+	bool			pending;
+};
+
+/* One emulated DEU, the registers are what the driver maps */
+struct deu_model {
+	u8			regs[DEU_MODEL_SIZE];
+	/* when BUS of each register block clears, in ktime_get_ns() time */
+	u64			busy_until[DEU_UNIT_NUM];
+	struct deu_model_aes	aes;
+	struct deu_model_des	des;
+	struct deu_model_hash	hash;
+};
+
+static struct deu_model *deu_model_of(struct deu_dev *deu)
+{
+	return container_of((u8 __force *)deu->base, struct deu_model,
+				regs[0]);
+}
+
+/*
+ * Encryption runs straight from the key registers. A changed key drops
+ * KV; PNK prepares the decryption schedule from the current key and sets
+ * KV again, then clears itself. KV is status, so it is kept here and
+ * only mirrored into CTRL, whatever the driver writes to it.
+ */
+static void deu_model_aes_key(struct deu_model_aes *model_aes,
+			struct aes_t *aes)
+{
+	int keylen = (aes->CTRL.bits.K + 2) * 8;
+	u32 *keyreg = &aes->K7R + (8 - keylen / 4);
+
+	model_aes->pnk_done = false;
+
+	if (keylen != model_aes->keylen ||
+			memcmp(model_aes->key, keyreg, keylen)) {
+		memcpy(model_aes->key, keyreg, keylen);
+		model_aes->keylen = keylen;
+		aes_expandkey(&model_aes->ctx, (u8 *)model_aes->key, keylen);
+		model_aes->kv = false;
+	}
+
+	if (aes->CTRL.bits.PNK) {
+		model_aes->dec = model_aes->ctx;
+		model_aes->kv = true;
+		model_aes->pnk_done = true;
+		aes->CTRL.bits.PNK = 0;
+	}
+
+	aes->CTRL.bits.KV = model_aes->kv;
+}
+
+/* Decrypt with the prepared schedule, stale if the driver skipped PNK */
+static void deu_model_aes_decrypt(struct deu_model_aes *model_aes,
+			u8 *out, const u8 *in)
+{
+	if (!model_aes->kv)
+		pr_warn_once("deu model: AES decryption without a valid key\n");
+
+	aes_decrypt(&model_aes->dec, out, in);
+}
+
+static void deu_model_aes_block(struct deu_model_aes *model_aes,
+			struct aes_t *aes)
+{
+	struct crypto_aes_ctx *ctx = &model_aes->ctx;
+	bool dec = aes->CTRL.bits.E_D;
+	u8 in[AES_BLOCK_SIZE];
+	u8 iv[AES_BLOCK_SIZE];
+	u8 ks[AES_BLOCK_SIZE];
+	u8 out[AES_BLOCK_SIZE];
+
+	deu_model_aes_key(model_aes, aes);
+
+	memcpy(in, &aes->ID3R, AES_BLOCK_SIZE);
+	memcpy(iv, &aes->IV3R, AES_BLOCK_SIZE);
+
+	switch (aes->CTRL.bits.O) {
+	case MODE_ECB:
+		if (dec)
+			deu_model_aes_decrypt(model_aes, out, in);
+		else
+			aes_encrypt(ctx, out, in);
+		break;
+	case MODE_CBC:
+		if (dec) {
+			deu_model_aes_decrypt(model_aes, out, in);
+			crypto_xor(out, iv, AES_BLOCK_SIZE);
+			memcpy(iv, in, AES_BLOCK_SIZE);
+		} else {
+			crypto_xor(in, iv, AES_BLOCK_SIZE);
+			aes_encrypt(ctx, out, in);
+			memcpy(iv, out, AES_BLOCK_SIZE);
+		}
+		break;
+	case MODE_OFB:
+		aes_encrypt(ctx, iv, iv);
+		crypto_xor_cpy(out, in, iv, AES_BLOCK_SIZE);
+		break;
+	case MODE_CFB:
+		aes_encrypt(ctx, ks, iv);
+		crypto_xor_cpy(out, in, ks, AES_BLOCK_SIZE);
+		memcpy(iv, dec ? in : out, AES_BLOCK_SIZE);
+		break;
+	case MODE_CTR:
+		aes_encrypt(ctx, ks, iv);
+		crypto_xor_cpy(out, in, ks, AES_BLOCK_SIZE);
+		crypto_inc(iv, AES_BLOCK_SIZE);
+		break;
+	default:
+		memset(out, 0, AES_BLOCK_SIZE);
+	}
+
+	memcpy(&aes->OD3R, out, AES_BLOCK_SIZE);
+	memcpy(&aes->IV3R, iv, AES_BLOCK_SIZE);
+}
+
+static void deu_model_des_key(struct deu_model_des *model_des,
+			struct des_t *des)
+{
+	int keylen = des->CTRL.bits.M ? (des->CTRL.bits.M - 1) * 8 : 8;
+
+	if (keylen == model_des->keylen &&
+			!memcmp(model_des->key, &des->K1HR, keylen))
+		return;
+
+	memcpy(model_des->key, &des->K1HR, keylen);
+	model_des->keylen = keylen;
+
+	/* weak keys were rejected at setkey, the schedule is valid anyway */
+	if (keylen == DES3_EDE_KEY_SIZE)
+		des3_ede_expand_key(&model_des->des3, (u8 *)model_des->key,
+					keylen);
+	else
+		des_expand_key(&model_des->des, (u8 *)model_des->key,
+					DES_KEY_SIZE);
+}
+
+static void deu_model_des_cipher(struct deu_model_des *model_des,
+			u8 *out, const u8 *in, bool dec)
+{
+	if (model_des->keylen == DES3_EDE_KEY_SIZE) {
+		if (dec)
+			des3_ede_decrypt(&model_des->des3, out, in);
+		else
+			des3_ede_encrypt(&model_des->des3, out, in);
+	} else {
+		if (dec)
+			des_decrypt(&model_des->des, out, in);
+		else
+			des_encrypt(&model_des->des, out, in);
+	}
+}
+
+static void deu_model_des_block(struct deu_model_des *model_des,
+			struct des_t *des)
+{
+	bool dec = des->CTRL.bits.E_D;
+	u8 in[DES_BLOCK_SIZE];
+	u8 iv[DES_BLOCK_SIZE];
+	u8 ks[DES_BLOCK_SIZE];
+	u8 out[DES_BLOCK_SIZE];
+
+	deu_model_des_key(model_des, des);
+
+	memcpy(in, &des->IHR, DES_BLOCK_SIZE);
+	memcpy(iv, &des->IVHR, DES_BLOCK_SIZE);
+
+	switch (des->CTRL.bits.O) {
+	case MODE_ECB:
+		deu_model_des_cipher(model_des, out, in, dec);
+		break;
+	case MODE_CBC:
+		if (dec) {
+			deu_model_des_cipher(model_des, out, in, true);
+			crypto_xor(out, iv, DES_BLOCK_SIZE);
+			memcpy(iv, in, DES_BLOCK_SIZE);
+		} else {
+			crypto_xor(in, iv, DES_BLOCK_SIZE);
+			deu_model_des_cipher(model_des, out, in, false);
+			memcpy(iv, out, DES_BLOCK_SIZE);
+		}
+		break;
+	case MODE_OFB:
+		deu_model_des_cipher(model_des, iv, iv, false);
+		crypto_xor_cpy(out, in, iv, DES_BLOCK_SIZE);
+		break;
+	case MODE_CFB:
+		deu_model_des_cipher(model_des, ks, iv, false);
+		crypto_xor_cpy(out, in, ks, DES_BLOCK_SIZE);
+		memcpy(iv, dec ? in : out, DES_BLOCK_SIZE);
+		break;
+	case MODE_CTR:
+		deu_model_des_cipher(model_des, ks, iv, false);
+		crypto_xor_cpy(out, in, ks, DES_BLOCK_SIZE);
+		crypto_inc(iv, DES_BLOCK_SIZE);
+		break;
+	default:
+		memset(out, 0, DES_BLOCK_SIZE);
+	}
+
+	memcpy(&des->OHR, out, DES_BLOCK_SIZE);
+	memcpy(&des->IVHR, iv, DES_BLOCK_SIZE);
+}
+
+static const u32 model_md5_k[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+	0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+	0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+	0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+	0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+	0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+	0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+	0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const u8 model_md5_r[16] = {
+	7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21,
+};
+
+/* The crypto library has no MD5, this is the RFC 1321 compression */
+static void deu_model_md5(u32 *state, const u32 *w)
+{
+	u32 a = state[0], b = state[1], c = state[2], d = state[3];
+	u32 f, tmp;
+	int i, g;
+
+	for (i = 0; i < 64; i++) {
+		switch (i / 16) {
+		case 0:
+			f = (b & c) | (~b & d);
+			g = i;
+			break;
+		case 1:
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) % 16;
+			break;
+		case 2:
+			f = b ^ c ^ d;
+			g = (3 * i + 5) % 16;
+			break;
+		default:
+			f = c ^ (b | ~d);
+			g = (7 * i) % 16;
+		}
+
+		tmp = d;
+		d = c;
+		c = b;
+		b += rol32(a + f + model_md5_k[i] + w[g],
+			model_md5_r[(i / 16) * 4 + i % 4]);
+		a = tmp;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+static void deu_model_hash_block(struct deu_model_hash *model_hash,
+			struct hash_t *hash)
+{
+	u32 *state = &hash->D1R;
+	u8 block[DEU_HASH_BLOCK_SIZE];
+	u32 ws[SHA1_WORKSPACE_WORDS];
+	int i;
+
+	hash->CTRL.bits.INIT = 0;
+
+	if (!model_hash->pending)
+		return;
+	model_hash->pending = false;
+
+	if (hash->CTRL.bits.ALGM == HASH_ALGM_MD5) {
+		deu_model_md5(state, model_hash->data);
+		return;
+	}
+
+	for (i = 0; i < DEU_HASH_BLOCK_SIZE / 4; i++)
+		put_unaligned_be32(model_hash->data[i], block + 4 * i);
+
+	sha1_transform(state, (const char *)block, ws);
+	memzero_explicit(ws, sizeof(ws));
+}
+
+/* MR is a single register here, the driver passes each block along */
+void deu_model_hash_data(struct deu_unit *unit, const u32 *words)
+{
+	struct deu_model_hash *model_hash = &deu_model_of(unit->deu)->hash;
+
+	memcpy(model_hash->data, words, sizeof(model_hash->data));
+	model_hash->pending = true;
+}
+
+/*
+ * Called by deu_wait_ready() after the driver started a block. The
+ * result is computed at once, BUS then stays set for the block latency.
+ */
+void deu_model_run(struct deu_unit *unit)
+{
+	struct deu_model *dm = deu_model_of(unit->deu);
+	union deu_status *status = (union deu_status __force *)unit->base;
+	unsigned int ns;
+
+	switch (unit->id) {
+	case DEU_UNIT_AES:
+		deu_model_aes_block(&dm->aes,
+				(struct aes_t __force *)unit->base);
+		ns = READ_ONCE(model_aes_ns);
+		if (dm->aes.pnk_done)
+			ns += READ_ONCE(model_pnk_ns);
+		break;
+	case DEU_UNIT_DES:
+		deu_model_des_block(&dm->des,
+				(struct des_t __force *)unit->base);
+		ns = READ_ONCE(model_des_ns);
+		break;
+	case DEU_UNIT_HASH:
+		deu_model_hash_block(&dm->hash,
+				(struct hash_t __force *)unit->base);
+		ns = READ_ONCE(model_hash_ns);
+		break;
+	default:
+		return;
+	}
+
+	if (!ns)
+		return;
+
+	dm->busy_until[unit->id] = ktime_get_ns() + ns;
+	status->bits.BUS = 1;
+}
+
+/* Timing hook, called while the driver polls: drop BUS once done */
+void deu_model_poll(struct deu_unit *unit)
+{
+	struct deu_model *dm = deu_model_of(unit->deu);
+	union deu_status *status = (union deu_status __force *)unit->base;
+
+	if (!status->bits.BUS)
+		return;
+
+	if (ktime_get_ns() >= dm->busy_until[unit->id])
+		status->bits.BUS = 0;
+}
+
+/* Stand-in for the central DMA: push every block through the model */
+int deu_model_dma(struct deu_dev *deu, int algo, struct scatterlist *src,
+			struct scatterlist *dst, unsigned int nbytes)
+{
+	struct deu_model *dm = deu_model_of(deu);
+	struct aes_t *aes = (struct aes_t *)(dm->regs + DEU_AES_BASE);
+	struct des_t *des = (struct des_t *)(dm->regs + DEU_DES_BASE);
+	unsigned int bsize = DES_BLOCK_SIZE;
+	u8 buf[AES_BLOCK_SIZE];
+	unsigned int offset;
+	u64 ns = 0;
+
+	if (algo == DEU_DMA_ALGO_AES)
+		bsize = AES_BLOCK_SIZE;
+
+	for (offset = 0; offset < nbytes; offset += bsize) {
+		scatterwalk_map_and_copy(buf, src, offset, bsize, 0);
+
+		if (algo == DEU_DMA_ALGO_AES) {
+			memcpy(&aes->ID3R, buf, bsize);
+			deu_model_aes_block(&dm->aes, aes);
+			memcpy(buf, &aes->OD3R, bsize);
+			ns += READ_ONCE(model_aes_ns);
+			if (dm->aes.pnk_done)
+				ns += READ_ONCE(model_pnk_ns);
+		} else {
+			memcpy(&des->IHR, buf, bsize);
+			deu_model_des_block(&dm->des, des);
+			memcpy(buf, &des->OHR, bsize);
+			ns += READ_ONCE(model_des_ns);
+		}
+
+		scatterwalk_map_and_copy(buf, dst, offset, bsize, 1);
+	}
+
+	/* The CPU is free while the DMA runs, so sleep rather than spin */
+	if (ns)
+		fsleep(DIV_ROUND_UP_ULL(ns, NSEC_PER_USEC));
+
+	return 0;
+}
+
+bool deu_model_enabled(void)
+{
+	return model;
+}
+
+/* Devices to create when no devicetree node bound the driver */
+unsigned int deu_model_instances(void)
+{
+	return clamp_t(unsigned int, model_instances, 1, DEU_MODEL_MAX);
+}
+
+/* Registers of a fresh instance, zeroed like the model state */
+__iomem void *deu_model_init(struct device *dev)
+{
+	struct deu_model *dm;
+
+	dm = devm_kzalloc(dev, sizeof(*dm), GFP_KERNEL);
+	if (!dm)
+		return NULL;
+
+	dev_info(dev, "using the software register model\n");
+
+	return (void __force __iomem *)dm->regs;
+}
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0
+ *
+ * Copyright (C) 2021
+ *
+ * Richard van Schagen <vschagen@icloud.com>
+ */
+#ifndef _DEU_MODEL_H_
+#define _DEU_MODEL_H_
+
+#include <linux/device.h>
+#include <linux/scatterlist.h>
+
+#define DEU_MODEL_SIZE		0x100
+#define DEU_MODEL_MAX		4
+
+struct deu_dev;
+struct deu_unit;
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_DEU_MODEL)
+bool deu_model_enabled(void);
+unsigned int deu_model_instances(void);
+__iomem void *deu_model_init(struct device *dev);
+void deu_model_run(struct deu_unit *unit);
+void deu_model_poll(struct deu_unit *unit);
+int deu_model_dma(struct deu_dev *deu, int algo, struct scatterlist *src,
+			struct scatterlist *dst, unsigned int nbytes);
+void deu_model_hash_data(struct deu_unit *unit, const u32 *words);
+#else
+static inline bool deu_model_enabled(void)
+{
+	return false;
+}
+
+static inline unsigned int deu_model_instances(void)
+{
+	return 0;
+}
+
+static inline __iomem void *deu_model_init(struct device *dev)
+{
+	return NULL;
+}
+
+static inline void deu_model_run(struct deu_unit *unit)
+{
+}
+
+static inline void deu_model_poll(struct deu_unit *unit)
+{
+}
+
+static inline int deu_model_dma(struct deu_dev *deu, int algo,
+			struct scatterlist *src, struct scatterlist *dst,
+			unsigned int nbytes)
+{
+	return -ENODEV;
+}
+
+static inline void deu_model_hash_data(struct deu_unit *unit,
+			const u32 *words)
+{
+}
+#endif
+
+#endif /* _DEU_MODEL_H_ */
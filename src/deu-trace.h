@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: GPL-2.0
+ *
+ * Copyright (C) 2021
+ *
+ * Richard van Schagen <vschagen@icloud.com>
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ltq_deu
+
+#if !defined(_DEU_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _DEU_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+#include "deu-core.h"
+
+TRACE_DEFINE_ENUM(DEU_OP_DEC);
+TRACE_DEFINE_ENUM(DEU_OP_ENC);
+TRACE_DEFINE_ENUM(DEU_OP_HASH);
+
+#define deu_trace_op(op)					\
+	__print_symbolic(op,					\
+		{ DEU_OP_DEC,	"dec" },			\
+		{ DEU_OP_ENC,	"enc" },			\
+		{ DEU_OP_HASH,	"hash" })
+
+DECLARE_EVENT_CLASS(deu_req,
+	TP_PROTO(struct deu_alg_template *tmpl, unsigned int nbytes, int op),
+	TP_ARGS(tmpl, nbytes, op),
+
+	TP_STRUCT__entry(
+		__string(alg, deu_alg_name(tmpl))
+		__field(unsigned int, nbytes)
+		__field(int, mode)
+		__field(int, op)
+	),
+
+	TP_fast_assign(
+		__assign_str(alg, deu_alg_name(tmpl));
+		__entry->nbytes = nbytes;
+		__entry->mode = tmpl ? tmpl->mode : -1;
+		__entry->op = op;
+	),
+
+	TP_printk("%s nbytes=%u mode=%d %s", __get_str(alg), __entry->nbytes,
+		__entry->mode, deu_trace_op(__entry->op))
+);
+
+/* A request enters the driver, before the hardware / software decision */
+DEFINE_EVENT(deu_req, deu_request,
+	TP_PROTO(struct deu_alg_template *tmpl, unsigned int nbytes, int op),
+	TP_ARGS(tmpl, nbytes, op)
+);
+
+/* One walk or scatterlist step went through the unit */
+DEFINE_EVENT(deu_req, deu_walk,
+	TP_PROTO(struct deu_alg_template *tmpl, unsigned int nbytes, int op),
+	TP_ARGS(tmpl, nbytes, op)
+);
+
+/* Unit lock taken; tmpl is NULL for a batch of mixed algorithms */
+TRACE_EVENT(deu_lock,
+	TP_PROTO(struct deu_unit *unit, struct deu_alg_template *tmpl,
+		u64 wait_ns),
+	TP_ARGS(unit, tmpl, wait_ns),
+
+	TP_STRUCT__entry(
+		__field(int, deu)
+		__string(unit, unit->name)
+		__string(alg, deu_alg_name(tmpl))
+		__field(u64, wait_ns)
+	),
+
+	TP_fast_assign(
+		__entry->deu = unit->deu->id;
+		__assign_str(unit, unit->name);
+		__assign_str(alg, deu_alg_name(tmpl));
+		__entry->wait_ns = wait_ns;
+	),
+
+	TP_printk("deu%d %s %s wait_ns=%llu", __entry->deu, __get_str(unit),
+		__get_str(alg), __entry->wait_ns)
+);
+
+/* Key written to the unit; a resident key is not traced */
+TRACE_EVENT(deu_key_load,
+	TP_PROTO(struct deu_alg_template *tmpl, unsigned int keylen),
+	TP_ARGS(tmpl, keylen),
+
+	TP_STRUCT__entry(
+		__string(alg, deu_alg_name(tmpl))
+		__field(int, mode)
+		__field(unsigned int, keylen)
+	),
+
+	TP_fast_assign(
+		__assign_str(alg, deu_alg_name(tmpl));
+		__entry->mode = tmpl ? tmpl->mode : -1;
+		__entry->keylen = keylen;
+	),
+
+	TP_printk("%s mode=%d keylen=%u", __get_str(alg), __entry->mode,
+		__entry->keylen)
+);
+
+/* An engine request is finalized, latency_ns after it was queued */
+TRACE_EVENT(deu_complete,
+	TP_PROTO(struct deu_alg_template *tmpl, unsigned int nbytes, int op,
+		int err, u64 latency_ns),
+	TP_ARGS(tmpl, nbytes, op, err, latency_ns),
+
+	TP_STRUCT__entry(
+		__string(alg, deu_alg_name(tmpl))
+		__field(unsigned int, nbytes)
+		__field(int, mode)
+		__field(int, op)
+		__field(int, err)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__assign_str(alg, deu_alg_name(tmpl));
+		__entry->nbytes = nbytes;
+		__entry->mode = tmpl->mode;
+		__entry->op = op;
+		__entry->err = err;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("%s nbytes=%u mode=%d %s err=%d latency_ns=%llu",
+		__get_str(alg), __entry->nbytes, __entry->mode,
+		deu_trace_op(__entry->op), __entry->err, __entry->latency_ns)
+);
+
+#endif /* _DEU_TRACE_H_ */
+
+/* out of tree: define_trace.h finds this file through -I$(src) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE deu-trace
+#include <trace/define_trace.h>